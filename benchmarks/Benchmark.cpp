@@ -0,0 +1,111 @@
+#include "Benchmark.hpp"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+
+// Static TLS in the executable, so bumping it never allocates itself
+thread_local std::uint64_t t_allocationCount = 0;
+thread_local std::int64_t t_allocatedBytes = 0;
+
+}  // namespace
+
+#if defined(__GLIBC__)
+// Interpose the allocator so Qt's qMalloc and operator new are both accounted for
+extern "C" {
+
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(std::size_t size)
+{
+    ++t_allocationCount;
+
+    auto *result = __libc_malloc(size);
+    t_allocatedBytes += malloc_usable_size(result);
+    return result;
+}
+
+void *calloc(std::size_t count, std::size_t size)
+{
+    ++t_allocationCount;
+
+    auto *result = __libc_calloc(count, size);
+    t_allocatedBytes += malloc_usable_size(result);
+    return result;
+}
+
+void *realloc(void *pointer, std::size_t size)
+{
+    ++t_allocationCount;
+    t_allocatedBytes -= malloc_usable_size(pointer);
+
+    auto *result = __libc_realloc(pointer, size);
+    t_allocatedBytes += malloc_usable_size(result);
+    return result;
+}
+
+void free(void *pointer)
+{
+    // Usable sizes rather than requested ones, which is what a block actually costs
+    t_allocatedBytes -= malloc_usable_size(pointer);
+    __libc_free(pointer);
+}
+
+}  // extern "C"
+#endif
+
+namespace bench {
+
+std::uint64_t allocationCount() noexcept
+{
+    return t_allocationCount;
+}
+
+std::int64_t allocatedBytes() noexcept
+{
+    return t_allocatedBytes;
+}
+
+void printHeader(const QString &title)
+{
+    std::printf("\n%s\n", qPrintable(title));
+    std::printf("%-36s %8s %10s %14s %12s %12s\n", "benchmark", "size", "ops", "ns/op", "allocs/op", "bytes/op");
+}
+
+void report(const Result &result)
+{
+    std::printf("%-36s %8d %10lld %14.1f %12.2f %12.1f\n", qPrintable(result.name), result.size, static_cast<long long>(result.operations),
+                result.nanosecondsPerOperation, result.allocationsPerOperation, result.bytesPerOperation);
+    std::fflush(stdout);
+}
+
+void quietMessageHandler(QtMsgType type, const char *message)
+{
+    // Missing language pack strings are logged through qDebug on every lookup
+    if (type == QtDebugMsg)
+        return;
+
+    std::fprintf(stderr, "%s\n", message);
+}
+
+void useScratchHome()
+{
+    const auto path = QDir::tempPath() + "/meegram-benchmark-" + QString::number(QCoreApplication::applicationPid());
+
+    QDir().mkpath(path);
+    qputenv("HOME", QFile::encodeName(path));
+}
+
+}  // namespace bench
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QString>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace bench {
+
+// Number of heap allocations made by the calling thread so far
+std::uint64_t allocationCount() noexcept;
+
+// Bytes allocated minus bytes freed by the calling thread so far
+std::int64_t allocatedBytes() noexcept;
+
+struct Result
+{
+    QString name;
+    int size{};
+    std::int64_t operations{};
+    double nanosecondsPerOperation{};
+    double allocationsPerOperation{};
+    double bytesPerOperation{};
+};
+
+void printHeader(const QString &title);
+void report(const Result &result);
+
+void quietMessageHandler(QtMsgType type, const char *message);
+
+// Points HOME at a scratch directory, so that caches and indexes written by the store stay out of the real profile
+void useScratchHome();
+
+template <typename Function>
+Result measure(const QString &name, int size, std::int64_t operations, Function &&function)
+{
+    const auto allocationsBefore = allocationCount();
+    const auto bytesBefore = allocatedBytes();
+    const auto start = std::chrono::steady_clock::now();
+
+    function();
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    const auto allocations = allocationCount() - allocationsBefore;
+    const auto bytes = allocatedBytes() - bytesBefore;
+
+    const auto divisor = static_cast<double>(std::max<std::int64_t>(operations, 1));
+
+    Result result{name, size, operations, static_cast<double>(elapsed) / divisor, static_cast<double>(allocations) / divisor,
+                  static_cast<double>(bytes) / divisor};
+    report(result);
+
+    return result;
+}
+
+}  // namespace bench
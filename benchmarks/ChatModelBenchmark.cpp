@@ -0,0 +1,158 @@
+#include "Benchmark.hpp"
+#include "SyntheticData.hpp"
+
+#include "ChatModel.hpp"
+#include "ChatSearchIndex.hpp"
+#include "StorageManager.hpp"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QStringList>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr auto ChatIdBase = 1000000;
+constexpr auto SearchIterations = 100;
+
+// Drives the private slots of ChatModel through plain signal connections
+class ChatModelDriver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ChatModelDriver(ChatModel *model)
+    {
+        connect(this, SIGNAL(sortRequested()), model, SLOT(sortChats()));
+        connect(this, SIGNAL(chatItemUpdated(qint64, int)), model, SLOT(handleChatItem(qint64, int)));
+        connect(this, SIGNAL(chatPositionUpdated(qint64)), model, SLOT(handleChatPosition(qint64)));
+    }
+
+    void sort()
+    {
+        emit sortRequested();
+    }
+
+    void chatItem(qint64 chatId, int fields)
+    {
+        emit chatItemUpdated(chatId, fields);
+    }
+
+    void chatPosition(qint64 chatId)
+    {
+        emit chatPositionUpdated(chatId);
+    }
+
+signals:
+    void sortRequested();
+    void chatItemUpdated(qint64 chatId, int fields);
+    void chatPositionUpdated(qint64 chatId);
+};
+
+void addChats(int from, int to, int now)
+{
+    for (auto i = from; i < to; ++i)
+    {
+        synthetic::deliver(td::td_api::make_object<td::td_api::updateUser>(synthetic::makeUser(ChatIdBase + i)));
+        synthetic::deliver(td::td_api::make_object<td::td_api::updateNewChat>(synthetic::makeChat(ChatIdBase + i, i, now - i * 60)));
+    }
+}
+
+void run(int size)
+{
+    ChatModel model;
+    model.setChatList(TdApi::ChatListMain);
+
+    ChatModelDriver driver(&model);
+
+    const auto iterations = std::max(3, 20000 / size);
+
+    bench::measure("ChatModel::populate", size, iterations, [&] {
+        for (auto i = 0; i < iterations; ++i)
+            model.populate();
+    });
+
+    bench::measure("ChatModel::sortChats", size, iterations, [&] {
+        for (auto i = 0; i < iterations; ++i)
+            driver.sort();
+    });
+
+    while (model.canFetchMore())
+        model.fetchMore();
+
+    // The first pass fills the role cache, the second one is what scrolling a loaded list costs
+    const auto roles = model.roleNames();
+    for (const auto pass : {"cold", "warm"})
+    {
+        for (auto it = roles.constBegin(); it != roles.constEnd(); ++it)
+        {
+            bench::measure(QString("ChatModel::data(%1, %2)").arg(QString::fromLatin1(it.value()), pass), size, model.rowCount(), [&] {
+                for (auto row = 0; row < model.rowCount(); ++row)
+                    model.data(model.index(row), it.key());
+            });
+        }
+    }
+
+    bench::measure("ChatModel::handleChatItem", size, size, [&] {
+        for (auto i = 0; i < size; ++i)
+            driver.chatItem(ChatIdBase + (i * 7919) % size, StorageManager::ChatLastMessageField);
+    });
+
+    bench::measure("ChatModel::handleChatPosition", size, size, [&] {
+        for (auto i = 0; i < size; ++i)
+            driver.chatPosition(ChatIdBase + (i * 7919) % size);
+    });
+
+    // One search per keystroke, which has to stay well under a millisecond at 10k chats: a prefix matching every chat,
+    // two words, a substring through trigrams, a username and a miss
+    const auto &index = StorageManager::instance().chatSearchIndex();
+    for (const auto *query : {"c", "chat", "number 42", "umbe", "user_100", "nothing"})
+    {
+        bench::measure(QString("ChatSearchIndex::search(%1)").arg(query), size, SearchIterations, [&] {
+            for (auto i = 0; i < SearchIterations; ++i)
+                index.search(query, ChatSearchLimit);
+        });
+    }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInstallMsgHandler(bench::quietMessageHandler);
+
+    std::vector<int> sizes;
+    for (const auto &argument : app.arguments().mid(1))
+    {
+        sizes.push_back(argument.toInt());
+    }
+
+    if (sizes.empty())
+        sizes = {1000, 10000, 50000};
+
+    std::ranges::sort(sizes);
+
+    const auto now = static_cast<int>(QDateTime::currentDateTime().toTime_t());
+
+    // The store is a singleton, so it grows from one size to the next
+    auto populated = 0;
+    for (auto size : sizes)
+    {
+        if (size > populated)
+        {
+            bench::measure("StorageManager::updateNewChat", size, size - populated, [&] { addChats(populated, size, now); });
+            populated = size;
+        }
+
+        bench::printHeader(QString("ChatModel with %1 chats").arg(size));
+        run(size);
+    }
+
+    return 0;
+}
+
+#include "ChatModelBenchmark.moc"
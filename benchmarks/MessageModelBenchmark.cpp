@@ -0,0 +1,207 @@
+#include "Benchmark.hpp"
+#include "SyntheticData.hpp"
+
+#include "MessageModel.hpp"
+#include "StorageManager.hpp"
+
+#include <QApplication>
+#include <QDateTime>
+#include <QStringList>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr auto ChatIdBase = 3000000;
+
+// Every run gets a chat of its own, so that the search index sees each history for the first time
+qint64 addChat(int index, int now)
+{
+    const auto chatId = ChatIdBase + index;
+
+    // A private chat without unread messages, so that loading history does not send viewMessages
+    synthetic::deliver(td::td_api::make_object<td::td_api::updateUser>(synthetic::makeUser(chatId)));
+    synthetic::deliver(td::td_api::make_object<td::td_api::updateNewChat>(synthetic::makeChat(chatId, 4, now)));
+
+    return chatId;
+}
+
+// New messages are only appended while the chat's last message is a loaded row, as in a live chat
+void setLastMessage(qint64 chatId, qint64 messageId, int date)
+{
+    auto update = td::td_api::make_object<td::td_api::updateChatLastMessage>();
+    update->chat_id_ = chatId;
+    update->last_message_ = synthetic::makeTextMessage(chatId, messageId, chatId, date, "Last message");
+
+    synthetic::deliver(std::move(update));
+}
+
+// Ids of loaded messages spread over the whole history rather than clustered at one end
+qint64 loadedMessageId(int i, int size)
+{
+    return (1 + (static_cast<qint64>(i) * 7919) % size) << 20;
+}
+
+std::vector<td::td_api::object_ptr<td::td_api::Object>> makeNewMessages(qint64 chatId, int size, int count, int date)
+{
+    std::vector<td::td_api::object_ptr<td::td_api::Object>> updates;
+
+    for (auto i = 0; i < count; ++i)
+    {
+        const auto messageId = static_cast<qint64>(size + 1 + i) << 20;
+
+        updates.push_back(td::td_api::make_object<td::td_api::updateNewMessage>(
+            synthetic::makeTextMessage(chatId, messageId, chatId + i % 5, date + i, "New message " + std::to_string(i))));
+
+        auto lastMessage = td::td_api::make_object<td::td_api::updateChatLastMessage>();
+        lastMessage->chat_id_ = chatId;
+        lastMessage->last_message_ = synthetic::makeTextMessage(chatId, messageId, chatId, date + i, "New message");
+        updates.push_back(std::move(lastMessage));
+    }
+
+    return updates;
+}
+
+std::vector<td::td_api::object_ptr<td::td_api::Object>> makeEdits(qint64 chatId, int size, int count)
+{
+    std::vector<td::td_api::object_ptr<td::td_api::Object>> updates;
+
+    for (auto i = 0; i < count; ++i)
+    {
+        auto text = td::td_api::make_object<td::td_api::formattedText>();
+        text->text_ = "Edited message " + std::to_string(i);
+
+        auto content = td::td_api::make_object<td::td_api::messageText>();
+        content->text_ = std::move(text);
+
+        auto update = td::td_api::make_object<td::td_api::updateMessageContent>();
+        update->chat_id_ = chatId;
+        update->message_id_ = loadedMessageId(i, size);
+        update->new_content_ = std::move(content);
+        updates.push_back(std::move(update));
+    }
+
+    return updates;
+}
+
+std::vector<td::td_api::object_ptr<td::td_api::Object>> makeInteractionInfo(qint64 chatId, int size, int count)
+{
+    std::vector<td::td_api::object_ptr<td::td_api::Object>> updates;
+
+    for (auto i = 0; i < count; ++i)
+    {
+        auto interactionInfo = td::td_api::make_object<td::td_api::messageInteractionInfo>();
+        interactionInfo->view_count_ = 1000 + i;
+
+        auto update = td::td_api::make_object<td::td_api::updateMessageInteractionInfo>();
+        update->chat_id_ = chatId;
+        update->message_id_ = loadedMessageId(i, size);
+        update->interaction_info_ = std::move(interactionInfo);
+        updates.push_back(std::move(update));
+    }
+
+    return updates;
+}
+
+std::vector<td::td_api::object_ptr<td::td_api::Object>> makeDeletes(qint64 chatId, int size, int count)
+{
+    std::vector<td::td_api::object_ptr<td::td_api::Object>> updates;
+
+    // Distinct ids, a message is only deleted once
+    for (auto i = 0; i < count; ++i)
+    {
+        auto update = td::td_api::make_object<td::td_api::updateDeleteMessages>();
+        update->chat_id_ = chatId;
+        update->message_ids_.push_back((static_cast<qint64>(size) - i) << 20);
+        update->is_permanent_ = true;
+        updates.push_back(std::move(update));
+    }
+
+    return updates;
+}
+
+void replay(const QString &name, int size, std::vector<td::td_api::object_ptr<td::td_api::Object>> &&updates, int operations)
+{
+    bench::measure(name, size, operations, [&] {
+        for (auto &update : updates)
+            synthetic::deliver(std::move(update));
+    });
+}
+
+void run(int index, int size, int now)
+{
+    const auto chatId = addChat(index, now);
+
+    setLastMessage(chatId, static_cast<qint64>(size) << 20, now);
+
+    // What the td_api objects of a loaded window cost by themselves
+    td::td_api::object_ptr<td::td_api::messages> history;
+    bench::measure("td_api::message (retained)", size, size, [&] { history = synthetic::makeHistory(chatId, 1, size, now - size); });
+
+    MessageModel model;
+    model.setWindowSize(size);
+    model.setChatId(QString::number(chatId));
+
+    // Bytes per operation are what the model keeps on top of the messages; layouts are computed on the worker thread
+    bench::measure("MessageModel::handleMessages", size, size, [&] {
+        QMetaObject::invokeMethod(&model, "handleMessages", Qt::DirectConnection, Q_ARG(td::td_api::Object *, history.release()),
+                                  Q_ARG(qint64, 0), Q_ARG(int, 0));
+    });
+
+    // Resting at the bottom of the chat, so that new messages are followed
+    model.setViewport(model.rowCount() - 20, model.rowCount() - 1);
+
+    const auto names = model.roleNames();
+    for (auto it = names.constBegin(); it != names.constEnd(); ++it)
+    {
+        bench::measure(QString("MessageModel::data(%1)").arg(QString::fromLatin1(it.value())), size, model.rowCount(), [&] {
+            for (auto row = 0; row < model.rowCount(); ++row)
+                model.data(model.index(row), it.key());
+        });
+    }
+
+    // A tenth of the history per stream; each new message comes with its updateChatLastMessage
+    const auto count = std::max(1, size / 10);
+
+    replay("updateNewMessage", size, makeNewMessages(chatId, size, count, now), count);
+    replay("updateMessageContent", size, makeEdits(chatId, size, count), count);
+    replay("updateMessageInteractionInfo", size, makeInteractionInfo(chatId, size, count), count);
+    replay("updateDeleteMessages", size, makeDeletes(chatId, size, count), count);
+
+    // Deferred work of the models, such as coalesced refreshes, is not part of the numbers above
+    QCoreApplication::processEvents();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    // Text layout needs the font database, but no display is opened
+    QApplication app(argc, argv, false);
+
+    qInstallMsgHandler(bench::quietMessageHandler);
+
+    bench::useScratchHome();
+
+    std::vector<int> sizes;
+    for (const auto &argument : app.arguments().mid(1))
+    {
+        sizes.push_back(argument.toInt());
+    }
+
+    if (sizes.empty())
+        sizes = {1000, 10000, 100000};
+
+    std::ranges::sort(sizes);
+
+    const auto now = static_cast<int>(QDateTime::currentDateTime().toTime_t());
+
+    for (std::size_t i = 0; i < sizes.size(); ++i)
+    {
+        bench::printHeader(QString("MessageModel with %1 messages").arg(sizes[i]));
+        run(static_cast<int>(i), sizes[i], now);
+    }
+
+    return 0;
+}
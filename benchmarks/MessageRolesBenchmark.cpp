@@ -0,0 +1,193 @@
+#include "Benchmark.hpp"
+#include "SyntheticData.hpp"
+
+#include "MessageModel.hpp"
+#include "StorageManager.hpp"
+
+#include <QApplication>
+#include <QDateTime>
+#include <QStringList>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr auto ChatId = 2000000;
+
+QVariantMap toVariantMap(const td::td_api::MessageSender &sender)
+{
+    QVariantMap result;
+
+    if (sender.get_id() == td::td_api::messageSenderUser::ID)
+    {
+        result.insert("@type", "messageSenderUser");
+        result.insert("user_id", static_cast<const td::td_api::messageSenderUser &>(sender).user_id_);
+    }
+    else
+    {
+        result.insert("@type", "messageSenderChat");
+        result.insert("chat_id", static_cast<const td::td_api::messageSenderChat &>(sender).chat_id_);
+    }
+
+    return result;
+}
+
+// What the JSON path used to keep for every message before the roles read td_api::message directly
+QVariantMap toVariantMap(const td::td_api::message &message)
+{
+    QVariantMap result;
+    result.insert("@type", "message");
+    result.insert("id", message.id_);
+    result.insert("sender_id", toVariantMap(*message.sender_id_));
+    result.insert("chat_id", message.chat_id_);
+    result.insert("is_outgoing", message.is_outgoing_);
+    result.insert("is_pinned", message.is_pinned_);
+    result.insert("can_be_edited", message.can_be_edited_);
+    result.insert("can_be_forwarded", message.can_be_forwarded_);
+    result.insert("can_be_deleted_only_for_self", message.can_be_deleted_only_for_self_);
+    result.insert("can_be_deleted_for_all_users", message.can_be_deleted_for_all_users_);
+    result.insert("is_channel_post", message.is_channel_post_);
+    result.insert("contains_unread_mention", message.contains_unread_mention_);
+    result.insert("date", message.date_);
+    result.insert("edit_date", message.edit_date_);
+    result.insert("message_thread_id", message.message_thread_id_);
+    result.insert("via_bot_user_id", message.via_bot_user_id_);
+    result.insert("author_signature", QString::fromStdString(message.author_signature_));
+    result.insert("media_album_id", QString::number(message.media_album_id_));
+
+    if (message.interaction_info_)
+    {
+        QVariantMap interactionInfo;
+        interactionInfo.insert("@type", "messageInteractionInfo");
+        interactionInfo.insert("view_count", message.interaction_info_->view_count_);
+        interactionInfo.insert("forward_count", message.interaction_info_->forward_count_);
+        result.insert("interaction_info", interactionInfo);
+    }
+
+    const auto &text = *static_cast<const td::td_api::messageText &>(*message.content_).text_;
+
+    QVariantList entities;
+    for (const auto &entity : text.entities_)
+    {
+        QVariantMap type;
+        type.insert("@type", entity->type_->get_id() == td::td_api::textEntityTypeUrl::ID ? "textEntityTypeUrl" : "textEntityTypeBold");
+
+        QVariantMap value;
+        value.insert("@type", "textEntity");
+        value.insert("offset", entity->offset_);
+        value.insert("length", entity->length_);
+        value.insert("type", type);
+        entities.append(value);
+    }
+
+    QVariantMap formattedText;
+    formattedText.insert("@type", "formattedText");
+    formattedText.insert("text", QString::fromStdString(text.text_));
+    formattedText.insert("entities", entities);
+
+    QVariantMap content;
+    content.insert("@type", "messageText");
+    content.insert("text", formattedText);
+    result.insert("content", content);
+
+    return result;
+}
+
+// The roles the delegates bind, read the way the QVariantMap delegates used to
+QVariant mapData(const QVariantMap &message, int role)
+{
+    switch (role)
+    {
+        case MessageModel::ContentTypeRole:
+            return message.value("content").toMap().value("@type");
+        case MessageModel::TextRole:
+            return message.value("content").toMap().value("text");
+        case MessageModel::IsOutgoingRole:
+            return message.value("is_outgoing");
+        case MessageModel::SendingStateRole:
+            return message.value("sending_state").toMap().value("@type");
+        case MessageModel::DateRole:
+            return message.value("date");
+        default:
+            return {};
+    }
+}
+
+void run(int size, int now)
+{
+    const QList<int> roles = {MessageModel::ContentTypeRole, MessageModel::TextRole, MessageModel::IsOutgoingRole, MessageModel::SendingStateRole,
+                              MessageModel::DateRole};
+
+    // Retained bytes are what a loaded window costs, td_api objects are allocated by TDLib in either approach
+    td::td_api::object_ptr<td::td_api::messages> history;
+    bench::measure("td_api::message (retained)", size, size, [&] { history = synthetic::makeHistory(ChatId, 1, size, now - size); });
+
+    QList<QVariantMap> maps;
+    bench::measure("QVariantMap (retained)", size, size, [&] {
+        for (const auto &message : history->messages_)
+            maps.append(toVariantMap(*message));
+    });
+
+    MessageModel model;
+    model.setWindowSize(size);
+    model.setChatId(QString::number(ChatId));
+
+    bench::measure("MessageModel::handleMessages", size, size, [&] {
+        QMetaObject::invokeMethod(&model, "handleMessages", Qt::DirectConnection, Q_ARG(td::td_api::Object *, history.release()),
+                                  Q_ARG(qint64, 0), Q_ARG(int, 0));
+    });
+
+    const auto names = model.roleNames();
+    for (auto role : roles)
+    {
+        const auto name = QString::fromLatin1(names.value(role));
+
+        bench::measure(QString("QVariantMap::value(%1)").arg(name), size, maps.size(), [&] {
+            for (const auto &map : maps)
+                mapData(map, role);
+        });
+
+        bench::measure(QString("MessageModel::data(%1)").arg(name), size, model.rowCount(), [&] {
+            for (auto row = 0; row < model.rowCount(); ++row)
+                model.data(model.index(row), role);
+        });
+    }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    // Text layout needs the font database, but no display is opened
+    QApplication app(argc, argv, false);
+
+    qInstallMsgHandler(bench::quietMessageHandler);
+
+    bench::useScratchHome();
+
+    std::vector<int> sizes;
+    for (const auto &argument : app.arguments().mid(1))
+    {
+        sizes.push_back(argument.toInt());
+    }
+
+    if (sizes.empty())
+        sizes = {1000, 10000};
+
+    std::ranges::sort(sizes);
+
+    const auto now = static_cast<int>(QDateTime::currentDateTime().toTime_t());
+
+    // A private chat without unread messages, so that loading history does not send viewMessages
+    synthetic::deliver(td::td_api::make_object<td::td_api::updateUser>(synthetic::makeUser(ChatId)));
+    synthetic::deliver(td::td_api::make_object<td::td_api::updateNewChat>(synthetic::makeChat(ChatId, 4, now)));
+
+    for (auto size : sizes)
+    {
+        bench::printHeader(QString("Message roles over %1 messages").arg(size));
+        run(size, now);
+    }
+
+    return 0;
+}
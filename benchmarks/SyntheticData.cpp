@@ -0,0 +1,120 @@
+#include "SyntheticData.hpp"
+
+#include "StorageManager.hpp"
+
+#include <QMetaObject>
+
+#include <algorithm>
+
+namespace synthetic {
+
+td::td_api::object_ptr<td::td_api::user> makeUser(qint64 userId)
+{
+    auto user = td::td_api::make_object<td::td_api::user>();
+    user->id_ = userId;
+    user->first_name_ = "User";
+    user->last_name_ = std::to_string(userId);
+    user->usernames_ = td::td_api::make_object<td::td_api::usernames>();
+    user->usernames_->active_usernames_.push_back("user_" + std::to_string(userId));
+    user->status_ = td::td_api::make_object<td::td_api::userStatusRecently>();
+    user->type_ = td::td_api::make_object<td::td_api::userTypeRegular>();
+
+    return user;
+}
+
+td::td_api::object_ptr<td::td_api::chat> makeChat(qint64 chatId, int index, int date)
+{
+    auto chat = td::td_api::make_object<td::td_api::chat>();
+    chat->id_ = chatId;
+    chat->title_ = "Chat number " + std::to_string(index);
+
+    // Every third chat is a group, so sender names go through the user lookups as well
+    if (index % 3 == 0)
+        chat->type_ = td::td_api::make_object<td::td_api::chatTypeBasicGroup>(chatId);
+    else
+        chat->type_ = td::td_api::make_object<td::td_api::chatTypePrivate>(chatId);
+
+    auto position = td::td_api::make_object<td::td_api::chatPosition>();
+    position->list_ = td::td_api::make_object<td::td_api::chatListMain>();
+    position->order_ = (std::int64_t(date) << 32) + index;
+    position->is_pinned_ = index < 5;
+    chat->positions_.push_back(std::move(position));
+
+    chat->notification_settings_ = td::td_api::make_object<td::td_api::chatNotificationSettings>();
+    chat->notification_settings_->mute_for_ = index % 7 == 0 ? 3600 : 0;
+
+    chat->unread_count_ = index % 4;
+    chat->last_message_ = makeTextMessage(chatId, (std::int64_t(index) + 1) << 20, chatId, date, "Last message of chat " + std::to_string(index));
+
+    return chat;
+}
+
+td::td_api::object_ptr<td::td_api::message> makeTextMessage(qint64 chatId, qint64 messageId, qint64 senderUserId, int date, const std::string &text)
+{
+    auto formattedText = td::td_api::make_object<td::td_api::formattedText>();
+    formattedText->text_ = text;
+
+    auto content = td::td_api::make_object<td::td_api::messageText>();
+    content->text_ = std::move(formattedText);
+
+    auto message = td::td_api::make_object<td::td_api::message>();
+    message->id_ = messageId;
+    message->chat_id_ = chatId;
+    message->sender_id_ = td::td_api::make_object<td::td_api::messageSenderUser>(senderUserId);
+    message->date_ = date;
+    message->content_ = std::move(content);
+
+    return message;
+}
+
+td::td_api::object_ptr<td::td_api::messages> makeHistory(qint64 chatId, qint64 firstMessageId, int count, int date)
+{
+    auto result = td::td_api::make_object<td::td_api::messages>();
+    result->total_count_ = count;
+
+    for (auto i = 0; i < count; ++i)
+    {
+        const auto senderUserId = chatId + i % 5;
+
+        auto message = makeTextMessage(chatId, (firstMessageId + i) << 20, senderUserId, date + i,
+                                       "Message " + std::to_string(i) + " with a link to https://example.org and some bold words");
+
+        message->is_outgoing_ = i % 3 == 0;
+        message->can_be_deleted_only_for_self_ = true;
+
+        if (i % 2 == 0)
+        {
+            auto &text = *static_cast<td::td_api::messageText &>(*message->content_).text_;
+            text.entities_.push_back(td::td_api::make_object<td::td_api::textEntity>(
+                static_cast<int>(text.text_.find("https")), 19, td::td_api::make_object<td::td_api::textEntityTypeUrl>()));
+            text.entities_.push_back(td::td_api::make_object<td::td_api::textEntity>(
+                static_cast<int>(text.text_.find("bold")), 10, td::td_api::make_object<td::td_api::textEntityTypeBold>()));
+        }
+
+        if (i % 5 == 0)
+        {
+            message->interaction_info_ = td::td_api::make_object<td::td_api::messageInteractionInfo>();
+            message->interaction_info_->view_count_ = 100 + i;
+            message->interaction_info_->forward_count_ = i % 7;
+        }
+
+        result->messages_.push_back(std::move(message));
+    }
+
+    // TDLib returns history newest first
+    std::ranges::reverse(result->messages_);
+
+    return result;
+}
+
+void deliver(td::td_api::object_ptr<td::td_api::Object> &&object)
+{
+    auto *value = object.release();
+
+    // Invoking the signal through the meta object fans it out to all connected models
+    QMetaObject::invokeMethod(StorageManager::instance().client(), "result", Qt::DirectConnection, Q_ARG(td::td_api::Object *, value));
+
+    delete value;
+}
+
+}  // namespace synthetic
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <td/telegram/td_api.h>
+
+#include <QtGlobal>
+
+#include <string>
+
+namespace synthetic {
+
+td::td_api::object_ptr<td::td_api::user> makeUser(qint64 userId);
+
+td::td_api::object_ptr<td::td_api::chat> makeChat(qint64 chatId, int index, int date);
+
+td::td_api::object_ptr<td::td_api::message> makeTextMessage(qint64 chatId, qint64 messageId, qint64 senderUserId, int date, const std::string &text);
+
+// A page of text messages with ascending server ids, every other one carrying entities and every fifth one
+// interaction info, the way a busy group looks
+td::td_api::object_ptr<td::td_api::messages> makeHistory(qint64 chatId, qint64 firstMessageId, int count, int date);
+
+// Hands an update to every receiver of Client::result, the same way the TDLib receive loop does
+void deliver(td::td_api::object_ptr<td::td_api::Object> &&object);
+
+}  // namespace synthetic
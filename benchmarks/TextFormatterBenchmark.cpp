@@ -0,0 +1,379 @@
+#include "Benchmark.hpp"
+
+#include "TextFormatter.hpp"
+
+#include <QCoreApplication>
+#include <QStringList>
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Messages of one size are formatted this many times; corpora are formatted once per message, the way the model
+// formats a page of history
+constexpr auto Iterations = 2000;
+
+// Words of a chat message; Cyrillic and emoji make UTF-8 and UTF-16 offsets differ, the way real messages do
+const QStringList Words = {
+    QString::fromUtf8("hello"), QString::fromUtf8("привет"), QString::fromUtf8("\xF0\x9F\x98\x80"), QString::fromUtf8("<tag>"),
+    QString::fromUtf8("a&b"),   QString::fromUtf8("мир"),    QString::fromUtf8("world"),           QString::fromUtf8("line\nbreak"),
+};
+
+td::td_api::object_ptr<td::td_api::textEntity> makeEntity(int offset, int length, td::td_api::object_ptr<td::td_api::TextEntityType> &&type)
+{
+    return td::td_api::make_object<td::td_api::textEntity>(offset, length, std::move(type));
+}
+
+td::td_api::object_ptr<td::td_api::TextEntityType> makeEntityType(int index)
+{
+    switch (index % 7)
+    {
+        case 0:
+            return td::td_api::make_object<td::td_api::textEntityTypeBold>();
+        case 1:
+            return td::td_api::make_object<td::td_api::textEntityTypeItalic>();
+        case 2:
+            return td::td_api::make_object<td::td_api::textEntityTypeUrl>();
+        case 3:
+            return td::td_api::make_object<td::td_api::textEntityTypeTextUrl>("https://example.org/?a=1&b=2");
+        case 4:
+            return td::td_api::make_object<td::td_api::textEntityTypeMention>();
+        case 5:
+            return td::td_api::make_object<td::td_api::textEntityTypeCode>();
+        default:
+            return td::td_api::make_object<td::td_api::textEntityTypeStrikethrough>();
+    }
+}
+
+// A message with the given number of entities over words of its text: every third entity has a bold one nested
+// in it and every fifth overlaps the next word, so that all paths of the formatter are taken
+td::td_api::object_ptr<td::td_api::formattedText> makeFormattedText(int entityCount)
+{
+    const auto wordCount = std::max(entityCount, 40);
+
+    QString text;
+    std::vector<std::pair<int, int>> words;
+
+    for (auto i = 0; i < wordCount; ++i)
+    {
+        const auto &word = Words.at(i % Words.size());
+
+        words.emplace_back(text.size(), word.size());
+        text += word;
+        text += QLatin1Char(' ');
+    }
+
+    auto result = td::td_api::make_object<td::td_api::formattedText>();
+    result->text_ = text.toUtf8().constData();
+
+    for (auto i = 0, added = 0; added < entityCount; ++i)
+    {
+        const auto [offset, length] = words[i % words.size()];
+
+        if (i % 5 == 4 && i + 1 < static_cast<int>(words.size()))
+        {
+            // Ends one character into the next word, never between the halves of a surrogate pair
+            auto end = words[i + 1].first + 1;
+            if (text.at(end - 1).isHighSurrogate())
+                ++end;
+
+            result->entities_.emplace_back(makeEntity(offset, end - offset, makeEntityType(i)));
+        }
+        else
+        {
+            result->entities_.emplace_back(makeEntity(offset, length, makeEntityType(i)));
+        }
+
+        if (++added < entityCount && i % 3 == 0 && length > 2)
+        {
+            result->entities_.emplace_back(makeEntity(offset, length - 1, td::td_api::make_object<td::td_api::textEntityTypeBold>()));
+            ++added;
+        }
+    }
+
+    return result;
+}
+
+using Corpus = std::vector<td::td_api::object_ptr<td::td_api::formattedText>>;
+
+// Builds a message while keeping UTF-16 offsets of what was appended, the unit entity offsets are in
+class TextBuilder
+{
+public:
+    int append(const QString &part)
+    {
+        const auto offset = m_text.size();
+        m_text += part;
+        return offset;
+    }
+
+    void addEntity(int offset, int length, td::td_api::object_ptr<td::td_api::TextEntityType> &&type)
+    {
+        m_entities.emplace_back(makeEntity(offset, length, std::move(type)));
+    }
+
+    // Appends part as one entity
+    void append(const QString &part, td::td_api::object_ptr<td::td_api::TextEntityType> &&type)
+    {
+        addEntity(append(part), part.size(), std::move(type));
+    }
+
+    td::td_api::object_ptr<td::td_api::formattedText> take()
+    {
+        auto result = td::td_api::make_object<td::td_api::formattedText>(m_text.toUtf8().constData(), std::move(m_entities));
+
+        m_text.clear();
+        m_entities.clear();
+
+        return result;
+    }
+
+private:
+    QString m_text;
+    std::vector<td::td_api::object_ptr<td::td_api::textEntity>> m_entities;
+};
+
+// Short lines of a group chat; every fifth starts with a bold word, the rest have their links found by the formatter
+Corpus makeChatLines(int count)
+{
+    const QStringList lines = {
+        QString::fromUtf8("ok"),
+        QString::fromUtf8("see you at 7"),
+        QString::fromUtf8("привет, как дела?"),
+        QString::fromUtf8("check https://example.org/page?id=42&ref=chat"),
+        QString::fromUtf8("@durov thanks, works now"),
+        QString::fromUtf8("#news the build is green again"),
+        QString::fromUtf8("if (a < b && c > d) return;"),
+        QString::fromUtf8("lol \xF0\x9F\x98\x82"),
+        QString::fromUtf8("who's coming tomorrow? www.example.com/event has the details"),
+    };
+
+    Corpus corpus;
+    TextBuilder builder;
+
+    for (auto i = 0; i < count; ++i)
+    {
+        const auto &line = lines.at(i % lines.size());
+
+        if (i % 5 == 0)
+        {
+            const auto word = line.section(QLatin1Char(' '), 0, 0);
+
+            builder.append(word, td::td_api::make_object<td::td_api::textEntityTypeBold>());
+            builder.append(line.mid(word.size()));
+        }
+        else
+        {
+            builder.append(line);
+        }
+
+        corpus.emplace_back(builder.take());
+    }
+
+    return corpus;
+}
+
+// Channel posts: paragraphs with a bold lead, italics nested in it, text links, mentions and hashtags
+Corpus makePosts(int count, int paragraphs)
+{
+    Corpus corpus;
+    TextBuilder builder;
+
+    for (auto i = 0; i < count; ++i)
+    {
+        for (auto paragraph = 0; paragraph < paragraphs; ++paragraph)
+        {
+            const auto lead = builder.append(QString::fromUtf8("Важно: "));
+            builder.append(QString::fromUtf8("release %1 is out").arg(paragraph), td::td_api::make_object<td::td_api::textEntityTypeItalic>());
+            builder.addEntity(lead, builder.append(QString::fromUtf8(". ")) - lead, td::td_api::make_object<td::td_api::textEntityTypeBold>());
+
+            builder.append(QString::fromUtf8("It fixes the crash on start & speeds up <b>loading</b>; read "));
+            builder.append(QString::fromUtf8("the changelog"), td::td_api::make_object<td::td_api::textEntityTypeTextUrl>("https://example.org/changelog?v=1&lang=en"));
+            builder.append(QString::fromUtf8(" or ask "));
+            builder.append(QString::fromUtf8("@support_bot"), td::td_api::make_object<td::td_api::textEntityTypeMention>());
+            builder.append(QString::fromUtf8(" \xF0\x9F\x9A\x80 "));
+            builder.append(QString::fromUtf8("#release"), td::td_api::make_object<td::td_api::textEntityTypeHashtag>());
+            builder.append(QString::fromUtf8("\n\n"));
+        }
+
+        corpus.emplace_back(builder.take());
+    }
+
+    return corpus;
+}
+
+// Pasted code: a pre block full of characters that need escaping, an inline code span and a line break after the block
+Corpus makeCodeBlocks(int count)
+{
+    const auto code = QString::fromUtf8("template <typename T>\n"
+                                        "bool less(const T &a, const T &b)\n"
+                                        "{\n"
+                                        "    return a < b && !(b < a);\n"
+                                        "}\n"
+                                        "\n"
+                                        "std::cout << \"a & b\" << std::endl;");
+
+    Corpus corpus;
+    TextBuilder builder;
+
+    for (auto i = 0; i < count; ++i)
+    {
+        builder.append(QString::fromUtf8("Try this:\n"));
+
+        if (i % 2 == 0)
+            builder.append(code, td::td_api::make_object<td::td_api::textEntityTypePre>());
+        else
+            builder.append(code, td::td_api::make_object<td::td_api::textEntityTypePreCode>("cpp"));
+
+        builder.append(QString::fromUtf8("\nthen call "));
+        builder.append(QString::fromUtf8("less<int>(1, 2)"), td::td_api::make_object<td::td_api::textEntityTypeCode>());
+        builder.append(QString::fromUtf8(" and it should print true"));
+
+        corpus.emplace_back(builder.take());
+    }
+
+    return corpus;
+}
+
+// Reactions in words: single emoji, skin tones, families joined by ZWJ, flags and variation selectors
+Corpus makeEmojiText(int count)
+{
+    const QStringList emoji = {
+        QString::fromUtf8("\xF0\x9F\x98\x80"),
+        QString::fromUtf8("\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD"),
+        QString::fromUtf8("\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7"),
+        QString::fromUtf8("\xF0\x9F\x87\xB7\xF0\x9F\x87\xBA"),
+        QString::fromUtf8("\xE2\x9D\xA4\xEF\xB8\x8F"),
+        QString::fromUtf8("\xF0\x9F\x8E\x89\xF0\x9F\x8E\x89\xF0\x9F\x8E\x89"),
+    };
+
+    Corpus corpus;
+    TextBuilder builder;
+
+    for (auto i = 0; i < count; ++i)
+    {
+        for (auto j = 0; j < 12; ++j)
+        {
+            builder.append(emoji.at((i + j) % emoji.size()));
+            builder.append(j % 3 == 0 ? QString::fromUtf8(" happy birthday ") : QString::fromUtf8(" "));
+        }
+
+        corpus.emplace_back(builder.take());
+    }
+
+    return corpus;
+}
+
+// Output size is what Text elements have to parse and what the rich text cache keeps
+void reportOutputSize(int size, qint64 textLength, qint64 htmlLength)
+{
+    std::printf("html: %.1f UTF-16 units per message, %.2f times the text\n", static_cast<double>(htmlLength) / std::max(size, 1),
+                static_cast<double>(htmlLength) / static_cast<double>(std::max<qint64>(textLength, 1)));
+    std::fflush(stdout);
+}
+
+void runCorpus(const Corpus &corpus)
+{
+    const auto size = static_cast<int>(corpus.size());
+
+    std::vector<TextFormatter::Source> sources;
+    qint64 textLength = 0;
+
+    for (const auto &formattedText : corpus)
+    {
+        sources.push_back(TextFormatter::toSource(*formattedText));
+        textLength += sources.back().text.size();
+    }
+
+    bench::measure("TextFormatter::toSource", size, size, [&] {
+        for (const auto &formattedText : corpus)
+            TextFormatter::toSource(*formattedText);
+    });
+
+    qint64 htmlLength = 0;
+    bench::measure("TextFormatter::toHtml(Source)", size, size, [&] {
+        for (const auto &source : sources)
+            htmlLength += TextFormatter::toHtml(source).size();
+    });
+
+    bench::measure("TextFormatter::toHtml(formattedText)", size, size, [&] {
+        for (const auto &formattedText : corpus)
+            TextFormatter::toHtml(*formattedText);
+    });
+
+    // What the QML element does for plain strings such as service messages, through the formattedTextChanged connection
+    TextFormatter formatter;
+    bench::measure("TextFormatter::applyFormatting", size, size, [&] {
+        for (const auto &source : sources)
+        {
+            formatter.setFormattedText(source.text);
+            formatter.text();
+        }
+    });
+
+    reportOutputSize(size, textLength, htmlLength);
+}
+
+void run(int entityCount)
+{
+    const auto formattedText = makeFormattedText(entityCount);
+    const auto source = TextFormatter::toSource(*formattedText);
+
+    bench::measure("TextFormatter::toSource", entityCount, Iterations, [&] {
+        for (auto i = 0; i < Iterations; ++i)
+            TextFormatter::toSource(*formattedText);
+    });
+
+    bench::measure("TextFormatter::toHtml(Source)", entityCount, Iterations, [&] {
+        for (auto i = 0; i < Iterations; ++i)
+            TextFormatter::toHtml(source);
+    });
+
+    bench::measure("TextFormatter::toHtml(formattedText)", entityCount, Iterations, [&] {
+        for (auto i = 0; i < Iterations; ++i)
+            TextFormatter::toHtml(*formattedText);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qInstallMsgHandler(bench::quietMessageHandler);
+
+    std::vector<int> entityCounts;
+    for (const auto &argument : app.arguments().mid(1))
+    {
+        entityCounts.push_back(argument.toInt());
+    }
+
+    if (entityCounts.empty())
+        entityCounts = {0, 10, 500};
+
+    std::ranges::sort(entityCounts);
+
+    for (auto entityCount : entityCounts)
+    {
+        bench::printHeader(QString("Text formatting with %1 entities").arg(entityCount));
+        run(entityCount);
+    }
+
+    bench::printHeader("Text formatting of short chat lines");
+    runCorpus(makeChatLines(10000));
+
+    bench::printHeader("Text formatting of long posts with many entities");
+    runCorpus(makePosts(200, 20));
+
+    bench::printHeader("Text formatting of code blocks");
+    runCorpus(makeCodeBlocks(2000));
+
+    bench::printHeader("Text formatting of emoji-heavy text");
+    runCorpus(makeEmojiText(2000));
+
+    return 0;
+}
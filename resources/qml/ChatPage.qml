@@ -131,19 +131,22 @@ Page {
                             id: loader
                             width: parent.width
                             height: childrenRect.height
-                            sourceComponent: model.isServiceMessage ? textMessageComponent : deleglateChooser.get(model.content)
+                            sourceComponent: model.isServiceMessage ? textMessageComponent : deleglateChooser.get(model.contentType)
 
                             Component {
                                 id: textMessageComponent
 
                                 MessageBubble {
-                                    childrenWidth: messageText.paintedWidth
+                                    // Laid out ahead by the model, measured here only until then
+                                    childrenWidth: (isPortrait ? model.portraitTextWidth : model.landscapeTextWidth) || messageText.paintedWidth
 
                                     content: FormattedText {
                                         id: messageText
-                                        formattedText: model.isServiceMessage ? model.serviceMessage.trim() : model.content.text
+                                        formattedText: model.isServiceMessage ? model.serviceMessage.trim() : ""
+                                        richText: model.isServiceMessage ? "" : model.richText
                                         color: model.isServiceMessage ? "gray" : model.isOutgoing ? "black" : "white"
                                         width: isPortrait ? 380 : 754
+                                        height: (isPortrait ? model.portraitTextHeight : model.landscapeTextHeight) || paintedHeight
                                         wrapMode: Text.WrapAtWordBoundaryOrAnywhere
                                         anchors {
                                             left: parent.left
@@ -183,8 +186,8 @@ Page {
 
                             QtObject {
                                 id: deleglateChooser
-                                function get(content) {
-                                    switch (content['@type']) {
+                                function get(contentType) {
+                                    switch (contentType) {
                                     case 'messageText':
                                         return textMessageComponent;
                                     default:
@@ -224,6 +227,21 @@ Page {
                             myMessageModel.loadHistory()
                     }
 
+                    onMovementEnded: updateViewport()
+
+                    // Rows that arrive without scrolling are on screen as well, once the view has settled
+                    onCountChanged: viewportTimer.restart()
+
+                    function updateViewport() {
+                        myMessageModel.setViewport(indexAt(width / 2, contentY), indexAt(width / 2, contentY + height - 1))
+                    }
+
+                    Timer {
+                        id: viewportTimer
+                        interval: 100
+                        onTriggered: listView.updateViewport()
+                    }
+
                     Connections {
                         target: inputContext
                         onSoftwareInputPanelVisibleChanged: {
@@ -324,6 +342,9 @@ Page {
         onMoreHistoriesLoaded: {
             listView.positionViewAtIndex(modelIndex - 1, ListView.Beginning)
         }
+        onAnchorRequested: {
+            listView.positionViewAtIndex(modelIndex, ListView.Beginning)
+        }
     }
 
     Component.onCompleted: { myMessageModel.openChat() }
@@ -80,9 +80,9 @@ Item {
             anchors.verticalCenter: parent.verticalCenter
             font.weight: Font.Light
             font.pixelSize: 22
-            color: mouseArea.pressed ? "#797979" : "#505050"
+            color: mouseArea.pressed ? "#797979" : model.chatAction !== "" ? "#0088cc" : "#505050"
             elide: Text.ElideRight
-            text: model.lastMessageContent
+            text: model.chatAction !== "" ? model.chatAction : model.lastMessageContent
         }
         Loader {
             id: bubbleLoader
@@ -6,12 +6,12 @@ Label {
     id: root
 
     property alias formattedText: content.formattedText
+    // Rich text prepared by the model, which takes precedence over formattedText
+    property string richText: ""
 
-    text: content.text
+    text: richText !== "" ? richText : content.text
 
     TextFormatter {
         id: content
-        // Use the same font as the label
-        font: root.font
     }
 }
@@ -16,7 +16,7 @@ Item {
 
     BorderImage {
         height: parent.height + (isOutgoing ? 2 : 0)
-        width: Math.max(childrenWidth, messageDate.paintedWidth + (model.isOutgoing ? 28 : 0),  senderLabel.paintedWidth) + 26
+        width: Math.max(childrenWidth, (model.dateWidth || messageDate.paintedWidth) + (model.isOutgoing ? 28 : 0), (model.showSender ? model.senderWidth : 0) || senderLabel.paintedWidth) + 26
         anchors {
             left: parent.left
             leftMargin: model.isServiceMessage ? (parent.width - width) / 2 : model.isOutgoing ? 10 : parent.width - width - 10
@@ -36,7 +36,7 @@ Item {
 
             onClicked:  root.clicked()
             onPressAndHold: {
-                if (myMessageModel.copyToClipboard(model.content)) {
+                if (myMessageModel.copyToClipboard(model.text)) {
                     banner.text = "Copy text to clipbord";
                     banner.show()
                 }
@@ -50,7 +50,8 @@ Item {
         width: parent.width -100
         anchors { left: parent.left; leftMargin: 80 }
         color: "white"
-        text: model.sender
+        // Only the first message of a run from one sender is labelled
+        text: model.showSender ? model.sender : ""
         font.pixelSize: 20
         font.bold: true
         wrapMode: Text.WrapAnywhere
@@ -0,0 +1,218 @@
+#include "ChatActionTracker.hpp"
+
+#include "Localization.hpp"
+#include "StorageManager.hpp"
+#include "Utils.hpp"
+
+#include <QStringList>
+#include <QTimer>
+
+#include <utility>
+
+namespace {
+
+qint64 getSenderId(const td::td_api::MessageSender &sender) noexcept
+{
+    if (sender.get_id() == td::td_api::messageSenderUser::ID)
+        return static_cast<const td::td_api::messageSenderUser &>(sender).user_id_;
+
+    return static_cast<const td::td_api::messageSenderChat &>(sender).chat_id_;
+}
+
+QString getActionString(std::int32_t actionId, Locale *locale)
+{
+    switch (actionId)
+    {
+        case td::td_api::chatActionRecordingVoiceNote::ID:
+        case td::td_api::chatActionUploadingVoiceNote::ID:
+            return locale->getString("RecordingAudio");
+        case td::td_api::chatActionUploadingPhoto::ID:
+            return locale->getString("SendingPhoto");
+        case td::td_api::chatActionRecordingVideo::ID:
+        case td::td_api::chatActionUploadingVideo::ID:
+            return locale->getString("SendingVideoStatus");
+        case td::td_api::chatActionUploadingDocument::ID:
+            return locale->getString("SendingFile");
+        case td::td_api::chatActionRecordingVideoNote::ID:
+        case td::td_api::chatActionUploadingVideoNote::ID:
+            return locale->getString("RecordingRound");
+        case td::td_api::chatActionStartPlayingGame::ID:
+            return locale->getString("SendingGame");
+        case td::td_api::chatActionChoosingSticker::ID:
+            return locale->getString("ChoosingSticker");
+        default:
+            return locale->getString("Typing");
+    }
+}
+
+}  // namespace
+
+ChatActionTracker::ChatActionTracker(StorageManager *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_timer(new QTimer(this))
+{
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(tick()));
+
+    m_timer->setInterval(TickInterval);
+}
+
+void ChatActionTracker::setAction(qint64 chatId, const td::td_api::MessageSender &sender, const td::td_api::ChatAction &action)
+{
+    const auto senderId = getSenderId(sender);
+
+    if (action.get_id() == td::td_api::chatActionCancel::ID)
+    {
+        // The wheel keeps its stale key, it is skipped once its slot comes up
+        if (auto it = m_actions.find(chatId); it != m_actions.end() && it->second.erase(senderId) > 0)
+        {
+            if (it->second.empty())
+                m_actions.erase(it);
+
+            m_dirtyChats.insert(chatId);
+        }
+        return;
+    }
+
+    auto &entry = m_actions[chatId][senderId];
+
+    // TDLib repeats active actions every few seconds, only a different action changes the summary
+    if (entry.actionId != action.get_id())
+    {
+        entry.actionId = action.get_id();
+        m_dirtyChats.insert(chatId);
+    }
+
+    entry.expiresAt = m_tick + ActionTimeoutTicks;
+    schedule({chatId, senderId}, entry.expiresAt);
+
+    if (!m_timer->isActive())
+        m_timer->start();
+}
+
+QString ChatActionTracker::summary(qint64 chatId) const
+{
+    if (auto it = m_summaries.find(chatId); it != m_summaries.end())
+        return it->second;
+
+    return {};
+}
+
+void ChatActionTracker::tick()
+{
+    ++m_tick;
+
+    // Every full turn of the inner wheel pulls the next outer slot down
+    if (m_tick % InnerSlotCount == 0)
+    {
+        const auto keys = std::exchange(m_outerWheel[(m_tick / InnerSlotCount) % OuterSlotCount], {});
+
+        for (const auto &key : keys)
+        {
+            if (const auto *action = find(key); action && action->expiresAt / InnerSlotCount == m_tick / InnerSlotCount)
+                schedule(key, action->expiresAt);
+        }
+    }
+
+    const auto keys = std::exchange(m_innerWheel[m_tick % InnerSlotCount], {});
+
+    for (const auto &key : keys)
+    {
+        expire(key);
+    }
+
+    const auto dirtyChats = std::exchange(m_dirtyChats, {});
+
+    for (auto chatId : dirtyChats)
+    {
+        auto value = buildSummary(chatId);
+
+        auto it = m_summaries.find(chatId);
+        if (it == m_summaries.end() ? value.isEmpty() : it->second == value)
+            continue;
+
+        if (value.isEmpty())
+            m_summaries.erase(it);
+        else
+            m_summaries[chatId] = std::move(value);
+
+        emit chatActionChanged(chatId);
+    }
+
+    if (m_actions.empty())
+        m_timer->stop();
+}
+
+void ChatActionTracker::schedule(const TimerKey &key, std::uint64_t expiresAt)
+{
+    if (expiresAt - m_tick < InnerSlotCount)
+        m_innerWheel[expiresAt % InnerSlotCount].push_back(key);
+    else
+        m_outerWheel[(expiresAt / InnerSlotCount) % OuterSlotCount].push_back(key);
+}
+
+void ChatActionTracker::expire(const TimerKey &key)
+{
+    auto it = m_actions.find(key.chatId);
+    if (it == m_actions.end())
+        return;
+
+    // A refreshed action has been scheduled again further down the wheel
+    auto action = it->second.find(key.senderId);
+    if (action == it->second.end() || action->second.expiresAt != m_tick)
+        return;
+
+    it->second.erase(action);
+
+    if (it->second.empty())
+        m_actions.erase(it);
+
+    m_dirtyChats.insert(key.chatId);
+}
+
+const ChatActionTracker::Action *ChatActionTracker::find(const TimerKey &key) const
+{
+    if (auto it = m_actions.find(key.chatId); it != m_actions.end())
+    {
+        if (auto action = it->second.find(key.senderId); action != it->second.end())
+            return &action->second;
+    }
+
+    return nullptr;
+}
+
+QString ChatActionTracker::buildSummary(qint64 chatId) const
+{
+    auto it = m_actions.find(chatId);
+    if (it == m_actions.end())
+        return {};
+
+    const auto &senders = it->second;
+
+    auto *locale = m_store->locale();
+
+    if (const auto *chat = m_store->chat(chatId); chat && chat->type_->get_id() == td::td_api::chatTypePrivate::ID)
+        return getActionString(senders.begin()->second.actionId, locale);
+
+    if (senders.size() > 2)
+        return locale->formatPluralString("AreTyping", static_cast<int>(senders.size()));
+
+    QStringList names;
+
+    for (const auto &[senderId, action] : senders)
+    {
+        if (senderId > 0)
+        {
+            names.append(Utils::getUserShortName(senderId, m_store, locale));
+        }
+        else if (const auto *chat = m_store->chat(senderId))
+        {
+            names.append(QString::fromStdString(chat->title_));
+        }
+    }
+
+    if (names.size() == 2)
+        return locale->getString("AreTypingGroup").arg(names.at(0), names.at(1));
+
+    return locale->getString("IsTypingGroup").arg(names.value(0));
+}
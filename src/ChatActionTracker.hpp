@@ -0,0 +1,75 @@
+#pragma once
+
+#include <td/telegram/td_api.h>
+
+#include <QObject>
+#include <QString>
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class QTimer;
+class StorageManager;
+
+// Aggregates updateChatAction per chat and expires the actions through a single
+// two-level timer wheel; summaries are rebuilt and announced at most once per tick.
+class ChatActionTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ChatActionTracker(StorageManager *store, QObject *parent = nullptr);
+
+    void setAction(qint64 chatId, const td::td_api::MessageSender &sender, const td::td_api::ChatAction &action);
+
+    [[nodiscard]] QString summary(qint64 chatId) const;
+
+signals:
+    void chatActionChanged(qint64 chatId);
+
+private slots:
+    void tick();
+
+private:
+    static constexpr auto TickInterval = 250;  // msec
+    static constexpr auto ActionTimeoutTicks = 24;  // 6 sec, as TDLib resends active actions every 5 sec
+
+    // The inner wheel spans 4 sec in ticks, the outer one 64 sec in inner turns
+    static constexpr auto InnerSlotCount = 16;
+    static constexpr auto OuterSlotCount = 16;
+
+    struct Action
+    {
+        std::int32_t actionId{};
+        std::uint64_t expiresAt{};
+    };
+
+    struct TimerKey
+    {
+        qint64 chatId{};
+        qint64 senderId{};
+    };
+
+    void schedule(const TimerKey &key, std::uint64_t expiresAt);
+    void expire(const TimerKey &key);
+
+    [[nodiscard]] const Action *find(const TimerKey &key) const;
+
+    QString buildSummary(qint64 chatId) const;
+
+    StorageManager *m_store{};
+
+    QTimer *m_timer;
+
+    std::uint64_t m_tick{};
+
+    std::array<std::vector<TimerKey>, InnerSlotCount> m_innerWheel;
+    std::array<std::vector<TimerKey>, OuterSlotCount> m_outerWheel;
+
+    std::unordered_map<qint64, std::unordered_map<qint64, Action>> m_actions;
+    std::unordered_map<qint64, QString> m_summaries;
+    std::unordered_set<qint64> m_dirtyChats;
+};
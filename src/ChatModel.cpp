@@ -13,32 +13,39 @@
 
 #include <algorithm>
 
-namespace detail {
+namespace {
 
-QString chatTypeString(const td::td_api::object_ptr<td::td_api::ChatType> &type)
+constexpr std::uint32_t roleBit(int role) noexcept
 {
-    switch (type->get_id())
-    {
-        case td::td_api::chatTypePrivate::ID:
-            return "private";
+    return 1u << (role - ChatModel::IdRole);
+}
 
-        case td::td_api::chatTypeSecret::ID:
-            return "secret";
+std::uint32_t rolesForFields(int fields) noexcept
+{
+    std::uint32_t result = 0;
 
-        case td::td_api::chatTypeBasicGroup::ID:
-            return "group";
+    if (fields & StorageManager::ChatTitleField)
+        result |= roleBit(ChatModel::TitleRole);
 
-        case td::td_api::chatTypeSupergroup::ID: {
-            const auto *value = static_cast<const td::td_api::chatTypeSupergroup *>(type.get());
-            return value->is_channel_ ? "channel" : "supergroup";
-        }
+    if (fields & StorageManager::ChatPhotoField)
+        result |= roleBit(ChatModel::PhotoRole);
 
-        default:
-            return {};
-    }
+    if (fields & StorageManager::ChatLastMessageField)
+        result |= roleBit(ChatModel::LastMessageSenderRole) | roleBit(ChatModel::LastMessageContentRole) | roleBit(ChatModel::LastMessageDateRole);
+
+    if (fields & StorageManager::ChatReadInboxField)
+        result |= roleBit(ChatModel::UnreadCountRole);
+
+    if (fields & StorageManager::ChatUnreadMentionCountField)
+        result |= roleBit(ChatModel::UnreadMentionCountRole);
+
+    if (fields & StorageManager::ChatNotificationSettingsField)
+        result |= roleBit(ChatModel::IsMutedRole);
+
+    return result;
 }
 
-}  // namespace detail
+}  // namespace
 
 ChatModel::ChatModel(QObject *parent)
     : QAbstractListModel(parent)
@@ -50,8 +57,11 @@ ChatModel::ChatModel(QObject *parent)
     m_client = m_storageManager->client();
     m_locale = m_storageManager->locale();
 
-    connect(m_storageManager, SIGNAL(chatItemUpdated(qint64)), this, SLOT(handleChatItem(qint64)));
+    connect(m_storageManager, SIGNAL(chatItemUpdated(qint64, int)), this, SLOT(handleChatItem(qint64, int)));
     connect(m_storageManager, SIGNAL(chatPositionUpdated(qint64)), this, SLOT(handleChatPosition(qint64)));
+    connect(m_storageManager->chatActionTracker(), SIGNAL(chatActionChanged(qint64)), this, SLOT(handleChatAction(qint64)));
+    connect(m_storageManager->dateBuckets(), SIGNAL(dayChanged(qint32)), this, SLOT(handleDayChanged(qint32)));
+    connect(m_storageManager->settings(), SIGNAL(languagePackIdChanged()), this, SLOT(invalidateRoles()));
 
     connect(m_sortTimer, SIGNAL(timeout()), this, SLOT(sortChats()));
     connect(m_loadingTimer, SIGNAL(timeout()), this, SLOT(loadChats()));
@@ -105,14 +115,31 @@ void ChatModel::fetchMore(const QModelIndex &parent)
     endInsertRows();
 
     emit countChanged();
+
+    prefetchHistory();
 }
 
 QVariant ChatModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid())
+    if (!index.isValid() || role < IdRole || role >= IdRole + RoleCount)
         return {};
 
     const auto chatId = m_chatIds.at(index.row());
+
+    auto &cache = m_roleCache[chatId];
+
+    const auto slot = role - IdRole;
+    if (!(cache.valid & roleBit(role)))
+    {
+        cache.values[slot] = roleData(chatId, role);
+        cache.valid |= roleBit(role);
+    }
+
+    return cache.values[slot];
+}
+
+QVariant ChatModel::roleData(qint64 chatId, int role) const
+{
     const auto chat = m_storageManager->chat(chatId);
 
     switch (role)
@@ -120,7 +147,7 @@ QVariant ChatModel::data(const QModelIndex &index, int role) const
         case IdRole:
             return QString::number(chatId);
         case TypeRole:
-            return detail::chatTypeString(chat->type_);
+            return Utils::getChatType(*chat);
         case TitleRole:
             return Utils::getChatTitle(chatId, m_storageManager, m_locale, true);
         case PhotoRole: {
@@ -143,7 +170,7 @@ QVariant ChatModel::data(const QModelIndex &index, int role) const
         case LastMessageContentRole:
             return Utils::getContent(*chat->last_message_, m_storageManager, m_locale);
         case LastMessageDateRole: {
-            return Utils::getMessageDate(*chat->last_message_, m_locale);
+            return Utils::getMessageDate(*chat->last_message_, m_storageManager);
         }
         case IsPinnedRole:
             return Utils::getChatPosition(chat, m_chatList)->is_pinned_;
@@ -153,6 +180,8 @@ QVariant ChatModel::data(const QModelIndex &index, int role) const
             return chat->unread_mention_count_;
         case IsMutedRole:
             return chat->notification_settings_->mute_for_ > 0;
+        case ChatActionRole:
+            return m_storageManager->chatActionTracker()->summary(chatId);
         default:
             return {};
     }
@@ -173,6 +202,7 @@ QHash<int, QByteArray> ChatModel::roleNames() const
     roles[UnreadCountRole] = "unreadCount";
     roles[UnreadMentionCountRole] = "unreadMentionCount";
     roles[IsMutedRole] = "isMuted";
+    roles[ChatActionRole] = "chatAction";
 
     return roles;
 }
@@ -313,6 +343,7 @@ void ChatModel::clear()
 {
     beginResetModel();
     m_chatIds.clear();
+    m_roleCache.clear();
     m_count = 0;
     endResetModel();
 
@@ -361,20 +392,39 @@ void ChatModel::sortChats()
     std::ranges::sort(m_chatIds, sorter);
 
     emit layoutChanged();
+
+    prefetchHistory();
 }
 
-void ChatModel::handleChatItem(qint64 chatId)
+void ChatModel::prefetchHistory()
 {
-    if (auto it = std::ranges::find(m_chatIds, chatId); it != m_chatIds.end())
+    std::vector<qint64> candidates;
+
+    // Unread and pinned chats near the top are the ones likely to be opened next
+    for (int row = 0; row < m_count; ++row)
     {
-        auto index = std::distance(m_chatIds.begin(), it);
-        QModelIndex modelIndex = createIndex(static_cast<int>(index), 0);
-        emit dataChanged(modelIndex, modelIndex);
+        const auto chat = m_storageManager->chat(m_chatIds.at(row));
+        if (!chat)
+            continue;
+
+        const auto position = Utils::getChatPosition(chat, m_chatList);
+
+        if (chat->unread_count_ > 0 || (position && position->is_pinned_))
+            candidates.push_back(chat->id_);
     }
+
+    m_storageManager->historyPrefetcher()->setCandidates(candidates);
+}
+
+void ChatModel::handleChatItem(qint64 chatId, int fields)
+{
+    invalidateChatRoles(chatId, rolesForFields(fields));
 }
 
 void ChatModel::handleChatPosition(qint64 chatId)
 {
+    invalidateChatRoles(chatId, roleBit(IsPinnedRole));
+
     if (auto it = std::ranges::find(m_chatIds, chatId); it != m_chatIds.end())
     {
         // emit delayed event
@@ -383,6 +433,54 @@ void ChatModel::handleChatPosition(qint64 chatId)
     }
 }
 
+void ChatModel::handleChatAction(qint64 chatId)
+{
+    invalidateChatRoles(chatId, roleBit(ChatActionRole));
+}
+
+void ChatModel::handleDayChanged(qint32 since)
+{
+    // Only recent dates move to another bucket, older rows keep their cached date
+    for (int row = 0; row < m_count; ++row)
+    {
+        const auto chatId = m_chatIds.at(row);
+
+        if (const auto chat = m_storageManager->chat(chatId); chat && chat->last_message_ && chat->last_message_->date_ >= since)
+        {
+            if (auto it = m_roleCache.find(chatId); it != m_roleCache.end())
+                it->second.valid &= ~roleBit(LastMessageDateRole);
+
+            emit dataChanged(index(row), index(row));
+        }
+    }
+}
+
+void ChatModel::invalidateRoles()
+{
+    // Every cached string may depend on the language pack
+    m_roleCache.clear();
+
+    if (m_count > 0)
+        emit dataChanged(index(0), index(m_count - 1));
+}
+
+void ChatModel::invalidateChatRoles(qint64 chatId, std::uint32_t roles)
+{
+    if (roles == 0)
+        return;
+
+    // Chats outside of the current list keep their entry, so drop stale values regardless
+    if (auto it = m_roleCache.find(chatId); it != m_roleCache.end())
+        it->second.valid &= ~roles;
+
+    if (auto it = std::ranges::find(m_chatIds, chatId); it != m_chatIds.end())
+    {
+        auto index = std::distance(m_chatIds.begin(), it);
+        QModelIndex modelIndex = createIndex(static_cast<int>(index), 0);
+        emit dataChanged(modelIndex, modelIndex);
+    }
+}
+
 void ChatModel::loadChats()
 {
     auto request = td::td_api::make_object<td::td_api::loadChats>();
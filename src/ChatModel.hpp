@@ -5,6 +5,9 @@
 #include <QAbstractListModel>
 #include <QTimer>
 
+#include <array>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 class Client;
@@ -36,8 +39,11 @@ public:
         UnreadMentionCountRole,
         UnreadCountRole,
         IsMutedRole,
+        ChatActionRole,
     };
 
+    static constexpr auto RoleCount = ChatActionRole - IdRole + 1;
+
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 
     bool canFetchMore(const QModelIndex &parent = QModelIndex()) const override;
@@ -76,12 +82,28 @@ private slots:
     void loadChats();
     void sortChats();
 
-    void handleChatItem(qint64 chatId);
+    void handleChatItem(qint64 chatId, int fields);
     void handleChatPosition(qint64 chatId);
+    void handleChatAction(qint64 chatId);
+    void handleDayChanged(qint32 since);
+
+    void invalidateRoles();
 
 private:
+    struct RoleCache
+    {
+        std::array<QVariant, RoleCount> values;
+        std::uint32_t valid{};
+    };
+
+    QVariant roleData(qint64 chatId, int role) const;
+
+    void invalidateChatRoles(qint64 chatId, std::uint32_t roles);
+
     void clear();
 
+    void prefetchHistory();
+
     Client *m_client{};
     Locale *m_locale{};
     StorageManager *m_storageManager{};
@@ -96,4 +118,7 @@ private:
     QTimer *m_loadingTimer;
 
     std::vector<int64_t> m_chatIds;
+
+    // Role values per chat, read by delegates on every scroll and dropped per field on updates
+    mutable std::unordered_map<qint64, RoleCache> m_roleCache;
 };
@@ -0,0 +1,322 @@
+#include "ChatSearchIndex.hpp"
+
+#include "Utils.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr auto ExactMatchScore = 4;
+constexpr auto PrefixMatchScore = 3;
+constexpr auto SubstringMatchScore = 1;
+
+constexpr auto TrigramLength = 3;
+
+std::uint64_t makeTrigram(const QChar *data) noexcept
+{
+    return (std::uint64_t(data[0].unicode()) << 32) | (std::uint64_t(data[1].unicode()) << 16) | std::uint64_t(data[2].unicode());
+}
+
+// Postings are kept sorted, common trigrams are shared by most chats and a linear scan per chat would be quadratic
+template <typename Map, typename Key>
+void addPosting(Map &map, const Key &key, qint64 chatId)
+{
+    auto &postings = map[key];
+    if (auto it = std::ranges::lower_bound(postings, chatId); it == postings.end() || *it != chatId)
+    {
+        postings.insert(it, chatId);
+    }
+}
+
+template <typename Map, typename Key>
+void removePosting(Map &map, const Key &key, qint64 chatId)
+{
+    if (auto it = map.find(key); it != map.end())
+    {
+        if (auto posting = std::ranges::lower_bound(it->second, chatId); posting != it->second.end() && *posting == chatId)
+        {
+            it->second.erase(posting);
+        }
+
+        if (it->second.empty())
+        {
+            map.erase(it);
+        }
+    }
+}
+
+}  // namespace
+
+void ChatSearchIndex::setChat(qint64 chatId, const QString &title, qint64 userId, qint64 supergroupId)
+{
+    auto titleTerms = Utils::tokenizeText(title);
+
+    auto [it, inserted] = m_entries.try_emplace(chatId);
+    auto &entry = it->second;
+
+    if (!inserted)
+    {
+        if (entry.titleTerms == titleTerms && entry.userId == userId && entry.supergroupId == supergroupId)
+            return;
+
+        unlink(chatId, entry);
+
+        if (entry.userId != 0)
+            removePosting(m_userChats, entry.userId, chatId);
+
+        if (entry.supergroupId != 0)
+            removePosting(m_supergroupChats, entry.supergroupId, chatId);
+    }
+
+    entry.titleLength = title.size();
+    entry.titleTerms = std::move(titleTerms);
+    entry.userId = userId;
+    entry.supergroupId = supergroupId;
+
+    if (userId != 0)
+        addPosting(m_userChats, userId, chatId);
+
+    if (supergroupId != 0)
+        addPosting(m_supergroupChats, supergroupId, chatId);
+
+    rebuild(chatId, entry);
+}
+
+void ChatSearchIndex::removeChat(qint64 chatId)
+{
+    auto it = m_entries.find(chatId);
+    if (it == m_entries.end())
+        return;
+
+    unlink(chatId, it->second);
+
+    if (it->second.userId != 0)
+        removePosting(m_userChats, it->second.userId, chatId);
+
+    if (it->second.supergroupId != 0)
+        removePosting(m_supergroupChats, it->second.supergroupId, chatId);
+
+    m_entries.erase(it);
+}
+
+void ChatSearchIndex::setUser(qint64 userId, const QString &firstName, const QString &lastName, const QStringList &usernames)
+{
+    auto terms = Utils::tokenizeText(firstName) + Utils::tokenizeText(lastName);
+
+    for (const auto &username : usernames)
+    {
+        terms.append(Utils::foldText(username));
+    }
+
+    // User updates mostly carry status changes, so skip the relinking when the names are unchanged
+    if (auto it = m_userTerms.find(userId); it != m_userTerms.end() && it->second == terms)
+        return;
+
+    m_userTerms[userId] = std::move(terms);
+
+    if (auto it = m_userChats.find(userId); it != m_userChats.end())
+    {
+        for (auto chatId : it->second)
+        {
+            auto &entry = m_entries.at(chatId);
+
+            unlink(chatId, entry);
+            rebuild(chatId, entry);
+        }
+    }
+}
+
+void ChatSearchIndex::setSupergroup(qint64 supergroupId, const QStringList &usernames)
+{
+    QStringList terms;
+
+    for (const auto &username : usernames)
+    {
+        terms.append(Utils::foldText(username));
+    }
+
+    if (auto it = m_supergroupTerms.find(supergroupId); it != m_supergroupTerms.end() && it->second == terms)
+        return;
+
+    m_supergroupTerms[supergroupId] = std::move(terms);
+
+    if (auto it = m_supergroupChats.find(supergroupId); it != m_supergroupChats.end())
+    {
+        for (auto chatId : it->second)
+        {
+            auto &entry = m_entries.at(chatId);
+
+            unlink(chatId, entry);
+            rebuild(chatId, entry);
+        }
+    }
+}
+
+std::vector<qint64> ChatSearchIndex::search(const QString &query, int limit) const
+{
+    const auto words = Utils::tokenizeText(query);
+
+    if (words.isEmpty() || limit <= 0)
+        return {};
+
+    std::unordered_map<qint64, int> scores;
+
+    for (int i = 0; i < words.size(); ++i)
+    {
+        const auto &word = words.at(i);
+
+        std::unordered_map<qint64, int> matches;
+
+        // Prefix matches come straight from the ordered token map
+        for (auto it = m_tokens.lower_bound(word); it != m_tokens.end() && it->first.startsWith(word); ++it)
+        {
+            const auto score = it->first.size() == word.size() ? ExactMatchScore : PrefixMatchScore;
+
+            for (auto chatId : it->second)
+            {
+                auto &value = matches[chatId];
+                value = std::max(value, score);
+            }
+        }
+
+        // Substring matches: walk the rarest trigram of the word and verify the candidates
+        if (word.size() >= TrigramLength)
+        {
+            const std::vector<qint64> *candidates = nullptr;
+
+            for (int j = 0; j + TrigramLength <= word.size(); ++j)
+            {
+                auto it = m_trigrams.find(makeTrigram(word.constData() + j));
+                if (it == m_trigrams.end())
+                {
+                    candidates = nullptr;
+                    break;
+                }
+
+                if (!candidates || it->second.size() < candidates->size())
+                    candidates = &it->second;
+            }
+
+            if (candidates)
+            {
+                for (auto chatId : *candidates)
+                {
+                    if (matches.contains(chatId))
+                        continue;
+
+                    const auto &tokens = m_entries.at(chatId).tokens;
+                    if (std::ranges::any_of(tokens, [&word](const auto &token) { return token.contains(word); }))
+                    {
+                        matches.emplace(chatId, SubstringMatchScore);
+                    }
+                }
+            }
+        }
+
+        // Every word of the query has to match
+        if (i == 0)
+        {
+            scores = std::move(matches);
+        }
+        else
+        {
+            std::erase_if(scores, [&matches](auto &value) {
+                auto it = matches.find(value.first);
+                if (it == matches.end())
+                    return true;
+
+                value.second += it->second;
+                return false;
+            });
+        }
+
+        if (scores.empty())
+            return {};
+    }
+
+    std::vector<std::pair<qint64, int>> ranked(scores.begin(), scores.end());
+
+    const auto count = std::min<std::size_t>(ranked.size(), limit);
+
+    std::ranges::partial_sort(ranked, ranked.begin() + count, [this](const auto &a, const auto &b) {
+        if (a.second != b.second)
+            return a.second > b.second;
+
+        const auto lengthA = m_entries.at(a.first).titleLength;
+        const auto lengthB = m_entries.at(b.first).titleLength;
+
+        if (lengthA != lengthB)
+            return lengthA < lengthB;
+
+        return a.first > b.first;
+    });
+
+    std::vector<qint64> result;
+    result.reserve(count);
+
+    std::ranges::transform(ranked.begin(), ranked.begin() + count, std::back_inserter(result), [](const auto &value) { return value.first; });
+
+    return result;
+}
+
+int ChatSearchIndex::size() const noexcept
+{
+    return static_cast<int>(m_entries.size());
+}
+
+void ChatSearchIndex::rebuild(qint64 chatId, Entry &entry)
+{
+    entry.tokens.assign(entry.titleTerms.begin(), entry.titleTerms.end());
+
+    if (auto it = m_userTerms.find(entry.userId); entry.userId != 0 && it != m_userTerms.end())
+        entry.tokens.insert(entry.tokens.end(), it->second.begin(), it->second.end());
+
+    if (auto it = m_supergroupTerms.find(entry.supergroupId); entry.supergroupId != 0 && it != m_supergroupTerms.end())
+        entry.tokens.insert(entry.tokens.end(), it->second.begin(), it->second.end());
+
+    std::ranges::sort(entry.tokens);
+    entry.tokens.erase(std::ranges::unique(entry.tokens).begin(), entry.tokens.end());
+
+    entry.trigrams = trigramsOf(entry.tokens);
+
+    for (const auto &token : entry.tokens)
+    {
+        addPosting(m_tokens, token, chatId);
+    }
+
+    for (auto trigram : entry.trigrams)
+    {
+        addPosting(m_trigrams, trigram, chatId);
+    }
+}
+
+void ChatSearchIndex::unlink(qint64 chatId, const Entry &entry)
+{
+    for (const auto &token : entry.tokens)
+    {
+        removePosting(m_tokens, token, chatId);
+    }
+
+    for (auto trigram : entry.trigrams)
+    {
+        removePosting(m_trigrams, trigram, chatId);
+    }
+}
+
+std::vector<std::uint64_t> ChatSearchIndex::trigramsOf(const std::vector<QString> &tokens)
+{
+    std::vector<std::uint64_t> result;
+
+    for (const auto &token : tokens)
+    {
+        for (int i = 0; i + TrigramLength <= token.size(); ++i)
+        {
+            result.push_back(makeTrigram(token.constData() + i));
+        }
+    }
+
+    std::ranges::sort(result);
+    result.erase(std::ranges::unique(result).begin(), result.end());
+
+    return result;
+}
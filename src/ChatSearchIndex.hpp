@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Common.hpp"
+
+#include <QStringList>
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Incremental prefix/trigram index over chat titles, user names and public usernames.
+// Every term is case and diacritic folded; prefix lookups go through an ordered token map,
+// substring lookups through trigram posting lists.
+class ChatSearchIndex
+{
+public:
+    void setChat(qint64 chatId, const QString &title, qint64 userId = 0, qint64 supergroupId = 0);
+    void removeChat(qint64 chatId);
+
+    void setUser(qint64 userId, const QString &firstName, const QString &lastName, const QStringList &usernames);
+    void setSupergroup(qint64 supergroupId, const QStringList &usernames);
+
+    [[nodiscard]] std::vector<qint64> search(const QString &query, int limit) const;
+
+    [[nodiscard]] int size() const noexcept;
+
+private:
+    struct Entry
+    {
+        int titleLength{};
+        qint64 userId{};
+        qint64 supergroupId{};
+        QStringList titleTerms;
+        std::vector<QString> tokens;
+        std::vector<std::uint64_t> trigrams;
+    };
+
+    void rebuild(qint64 chatId, Entry &entry);
+    void unlink(qint64 chatId, const Entry &entry);
+
+    static std::vector<std::uint64_t> trigramsOf(const std::vector<QString> &tokens);
+
+    std::unordered_map<qint64, Entry> m_entries;
+
+    std::unordered_map<qint64, QStringList> m_userTerms;
+    std::unordered_map<qint64, QStringList> m_supergroupTerms;
+    std::unordered_map<qint64, std::vector<qint64>> m_userChats;
+    std::unordered_map<qint64, std::vector<qint64>> m_supergroupChats;
+
+    std::map<QString, std::vector<qint64>> m_tokens;
+    std::unordered_map<std::uint64_t, std::vector<qint64>> m_trigrams;
+};
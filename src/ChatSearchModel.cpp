@@ -0,0 +1,148 @@
+#include "ChatSearchModel.hpp"
+
+#include "Common.hpp"
+#include "StorageManager.hpp"
+#include "Utils.hpp"
+
+#include <utility>
+
+ChatSearchModel::ChatSearchModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+    m_storageManager = &StorageManager::instance();
+
+    m_locale = m_storageManager->locale();
+
+    connect(this, SIGNAL(queryChanged()), this, SLOT(refresh()));
+
+    // The store re-indexes before models see an update, it is connected to the client first
+    connect(m_storageManager->client(), SIGNAL(result(td::td_api::Object *)), SLOT(handleResult(td::td_api::Object *)));
+    connect(m_storageManager, SIGNAL(chatItemUpdated(qint64, int)), SLOT(handleChatItem(qint64, int)));
+
+    setRoleNames(roleNames());
+}
+
+int ChatSearchModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return static_cast<int>(m_chatIds.size());
+}
+
+QVariant ChatSearchModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return {};
+
+    const auto chatId = m_chatIds.at(index.row());
+    const auto chat = m_storageManager->chat(chatId);
+
+    if (!chat)
+        return {};
+
+    switch (role)
+    {
+        case IdRole:
+            return QString::number(chatId);
+        case TypeRole:
+            return Utils::getChatType(*chat);
+        case TitleRole:
+            return Utils::getChatTitle(chatId, m_storageManager, m_locale, true);
+        case PhotoRole: {
+            if (const auto &chatPhoto = chat->photo_; chatPhoto)
+            {
+                if (const auto &smallPhoto = chatPhoto->small_; smallPhoto)
+                {
+                    if (const auto &local = smallPhoto->local_; local && local->is_downloading_completed_)
+                    {
+                        return QString::fromStdString("image://chatPhoto/" + local->path_);
+                    }
+                }
+            }
+
+            return "image://theme/icon-l-content-avatar-placeholder";
+        }
+        case UnreadCountRole:
+            return chat->unread_count_;
+        case IsMutedRole:
+            return chat->notification_settings_->mute_for_ > 0;
+        default:
+            return {};
+    }
+}
+
+QHash<int, QByteArray> ChatSearchModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+
+    roles[IdRole] = "id";
+    roles[TypeRole] = "type";
+    roles[TitleRole] = "title";
+    roles[PhotoRole] = "photo";
+    roles[UnreadCountRole] = "unreadCount";
+    roles[IsMutedRole] = "isMuted";
+
+    return roles;
+}
+
+int ChatSearchModel::count() const noexcept
+{
+    return static_cast<int>(m_chatIds.size());
+}
+
+const QString &ChatSearchModel::query() const noexcept
+{
+    return m_query;
+}
+
+void ChatSearchModel::setQuery(const QString &value)
+{
+    if (m_query != value)
+    {
+        m_query = value;
+        emit queryChanged();
+    }
+}
+
+void ChatSearchModel::refresh()
+{
+    m_refreshQueued = false;
+
+    // The index answers from its own postings, so a keystroke never touches data() of other rows
+    beginResetModel();
+    m_chatIds = m_storageManager->chatSearchIndex().search(m_query, ChatSearchLimit);
+    endResetModel();
+
+    emit countChanged();
+}
+
+void ChatSearchModel::handleResult(td::td_api::Object *object)
+{
+    // Names and usernames of users and supergroups are searched too
+    switch (object->get_id())
+    {
+        case td::td_api::updateUser::ID:
+        case td::td_api::updateSupergroup::ID:
+            scheduleRefresh();
+            break;
+        default:
+            break;
+    }
+}
+
+void ChatSearchModel::handleChatItem(qint64 chatId, int fields)
+{
+    Q_UNUSED(chatId)
+
+    if (fields & StorageManager::ChatTitleField)
+        scheduleRefresh();
+}
+
+void ChatSearchModel::scheduleRefresh()
+{
+    if (m_query.isEmpty() || std::exchange(m_refreshQueued, true))
+        return;
+
+    QMetaObject::invokeMethod(this, "refresh", Qt::QueuedConnection);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <td/telegram/td_api.h>
+
+#include <QAbstractListModel>
+
+#include <vector>
+
+class Locale;
+class StorageManager;
+
+class ChatSearchModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(QString query READ query WRITE setQuery NOTIFY queryChanged)
+
+public:
+    explicit ChatSearchModel(QObject *parent = nullptr);
+
+    enum Roles {
+        IdRole = Qt::UserRole + 1,
+        TypeRole,
+        TitleRole,
+        PhotoRole,
+        UnreadCountRole,
+        IsMutedRole,
+    };
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    QHash<int, QByteArray> roleNames() const;
+
+    int count() const noexcept;
+
+    const QString &query() const noexcept;
+    void setQuery(const QString &value);
+
+signals:
+    void countChanged();
+    void queryChanged();
+
+public slots:
+    void refresh();
+
+private slots:
+    void handleResult(td::td_api::Object *object);
+    void handleChatItem(qint64 chatId, int fields);
+
+private:
+    // Updates come in bursts, the results are recomputed once for all of them
+    void scheduleRefresh();
+
+    Locale *m_locale{};
+    StorageManager *m_storageManager{};
+
+    QString m_query;
+
+    std::vector<qint64> m_chatIds;
+
+    bool m_refreshQueued = false;
+};
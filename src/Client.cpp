@@ -19,14 +19,23 @@ int Client::clientId() const noexcept
     return m_clientId;
 }
 
-void Client::send(td::td_api::object_ptr<td::td_api::Function> request, std::function<void(td::td_api::object_ptr<td::td_api::Object>)> callback)
+std::size_t Client::pendingRequestCount() const
+{
+    return m_interactiveRequestCount.load(std::memory_order_relaxed);
+}
+
+void Client::send(td::td_api::object_ptr<td::td_api::Function> request, std::function<void(td::td_api::object_ptr<td::td_api::Object>)> callback,
+                  bool background)
 {
     auto id = m_requestId.fetch_add(1, std::memory_order_relaxed);
     if (callback)
     {
         std::unique_lock lock(m_handlerMutex);
 
-        m_handlers.emplace(id, std::move(callback));
+        m_handlers.emplace(id, Handler{std::move(callback), background});
+
+        if (!background)
+            m_interactiveRequestCount.fetch_add(1, std::memory_order_relaxed);
     }
     m_clientManager->send(m_clientId, id, std::move(request));
 }
@@ -45,7 +54,7 @@ void Client::initialize()
 
             if (response.request_id != 0)
             {
-                std::function<void(td::td_api::object_ptr<td::td_api::Object>)> handler;
+                Handler handler;
                 {
                     std::shared_lock lock(m_handlerMutex);
                     auto it = m_handlers.find(response.request_id);
@@ -55,13 +64,16 @@ void Client::initialize()
                     }
                 }
 
-                if (handler)
+                if (handler.callback)
                 {
-                    handler(std::move(response.object));
+                    handler.callback(std::move(response.object));
                     {
                         std::unique_lock lock(m_handlerMutex);
                         m_handlers.erase(response.request_id);
                     }
+
+                    if (!handler.background)
+                        m_interactiveRequestCount.fetch_sub(1, std::memory_order_relaxed);
                 }
             }
             else
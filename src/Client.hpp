@@ -5,6 +5,7 @@
 
 #include <QObject>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <shared_mutex>
@@ -20,12 +21,23 @@ public:
 
     int clientId() const noexcept;
 
-    void send(td::td_api::object_ptr<td::td_api::Function> request, std::function<void(td::td_api::object_ptr<td::td_api::Object>)> callback);
+    // Interactive requests sent with a callback that have not been answered yet
+    std::size_t pendingRequestCount() const;
+
+    // Background requests are left out of the pending count, their senders wait for it to reach zero
+    void send(td::td_api::object_ptr<td::td_api::Function> request, std::function<void(td::td_api::object_ptr<td::td_api::Object>)> callback,
+              bool background = false);
 
 signals:
     void result(td::td_api::Object *object);
 
 private:
+    struct Handler
+    {
+        std::function<void(td::td_api::object_ptr<td::td_api::Object>)> callback;
+        bool background{};
+    };
+
     void initialize();
 
     int m_clientId;
@@ -33,7 +45,8 @@ private:
     std::unique_ptr<td::ClientManager> m_clientManager;
 
     std::jthread m_worker;
-    std::shared_mutex m_handlerMutex;
+    mutable std::shared_mutex m_handlerMutex;
     std::atomic<std::uint64_t> m_requestId{0};
-    std::unordered_map<std::uint64_t, std::function<void(td::td_api::object_ptr<td::td_api::Object>)>> m_handlers;
+    std::atomic<std::size_t> m_interactiveRequestCount{0};
+    std::unordered_map<std::uint64_t, Handler> m_handlers;
 };
@@ -27,6 +27,10 @@ constexpr auto WaitTimeout = 30.0;  // 30 sec
 
 constexpr auto ChatSliceLimit = 25;
 constexpr auto MessageSliceLimit = 20;
+constexpr auto MessageWindowSize = 200;
+constexpr auto MessageSearchLimit = 50;
+
+constexpr auto ChatSearchLimit = 50;
 
 constexpr auto MutedValueMax = 2147483647;  // int32.max = 2^32 - 1
 constexpr auto MutedValueMin = 0;
@@ -0,0 +1,110 @@
+#include "DateBuckets.hpp"
+
+#include "Localization.hpp"
+#include "StorageManager.hpp"
+
+#include <QDateTime>
+#include <QTimer>
+
+#include <algorithm>
+
+DateBuckets::DateBuckets(StorageManager *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_midnightTimer(new QTimer(this))
+{
+    connect(m_midnightTimer, SIGNAL(timeout()), this, SLOT(rollover()));
+    connect(m_store->settings(), SIGNAL(languagePackIdChanged()), this, SLOT(clearCache()));
+
+    m_midnightTimer->setSingleShot(true);
+
+    computeBoundaries();
+}
+
+QString DateBuckets::messageDate(qint32 date) const
+{
+    const auto index = dayIndex(date);
+
+    // Times of today are the only labels that differ within a day
+    if (index == 0)
+    {
+        if (m_timeFormat.isEmpty())
+            m_timeFormat = m_store->locale()->getString("formatterDay12H");
+
+        return QDateTime::fromTime_t(date).toString(m_timeFormat);
+    }
+
+    return day(date, index).date;
+}
+
+QString DateBuckets::section(qint32 date) const
+{
+    return day(date, dayIndex(date)).section;
+}
+
+void DateBuckets::rollover()
+{
+    const auto since = m_dayStarts.back();
+
+    computeBoundaries();
+    m_days.clear();
+
+    emit dayChanged(since);
+}
+
+void DateBuckets::clearCache()
+{
+    m_timeFormat.clear();
+    m_days.clear();
+}
+
+int DateBuckets::dayIndex(qint32 date) const noexcept
+{
+    if (date >= m_tomorrowStart)
+        return -1;
+
+    auto it = std::ranges::find_if(m_dayStarts, [date](auto start) { return date >= start; });
+    return it != m_dayStarts.end() ? static_cast<int>(std::distance(m_dayStarts.begin(), it)) : -1;
+}
+
+const DateBuckets::Day &DateBuckets::day(qint32 date, int index) const
+{
+    const auto julianDay = index >= 0 ? m_todayJulianDay - index : QDateTime::fromTime_t(date).date().toJulianDay();
+
+    auto [it, inserted] = m_days.try_emplace(julianDay);
+    if (inserted)
+    {
+        auto *locale = m_store->locale();
+
+        const auto value = QDate::fromJulianDay(julianDay);
+
+        it->second.date = value.toString(locale->getString(index > 0 ? "formatterWeek" : "formatterYear"));
+
+        if (index == 0)
+            it->second.section = locale->getString("Today");
+        else if (index == 1)
+            it->second.section = locale->getString("Yesterday");
+        else
+            it->second.section = value.toString(locale->getString("chatFullDate"));
+    }
+
+    return it->second;
+}
+
+void DateBuckets::computeBoundaries()
+{
+    const auto today = QDate::currentDate();
+
+    m_todayJulianDay = today.toJulianDay();
+
+    for (int i = 0; i < WeekDays; ++i)
+    {
+        m_dayStarts[i] = static_cast<qint32>(QDateTime(today.addDays(-i)).toTime_t());
+    }
+
+    m_tomorrowStart = static_cast<qint32>(QDateTime(today.addDays(1)).toTime_t());
+
+    // A second past midnight keeps the timer clear of the boundary itself
+    const auto now = static_cast<qint32>(QDateTime::currentDateTime().toTime_t());
+    m_midnightTimer->start((std::max(0, m_tomorrowStart - now) + 1) * 1000);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+#include <array>
+#include <unordered_map>
+
+class QTimer;
+class StorageManager;
+
+// Relative message dates ("Today", weekday, full date) resolved against day boundaries
+// computed once per day. Strings are cached per day and dropped at midnight, when
+// dayChanged reports the oldest timestamp whose label may have moved.
+class DateBuckets : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DateBuckets(StorageManager *store, QObject *parent = nullptr);
+
+    [[nodiscard]] QString messageDate(qint32 date) const;
+    [[nodiscard]] QString section(qint32 date) const;
+
+signals:
+    void dayChanged(qint32 since);
+
+private slots:
+    void rollover();
+    void clearCache();
+
+private:
+    static constexpr auto WeekDays = 7;
+
+    struct Day
+    {
+        QString date;
+        QString section;
+    };
+
+    [[nodiscard]] int dayIndex(qint32 date) const noexcept;
+    [[nodiscard]] const Day &day(qint32 date, int index) const;
+
+    void computeBoundaries();
+
+    StorageManager *m_store{};
+
+    QTimer *m_midnightTimer;
+
+    int m_todayJulianDay{};
+
+    // Start of today, yesterday and so on back to a week ago
+    std::array<qint32, WeekDays> m_dayStarts{};
+    qint32 m_tomorrowStart{};
+
+    mutable QString m_timeFormat;
+    mutable std::unordered_map<int, Day> m_days;
+};
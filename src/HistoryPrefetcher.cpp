@@ -0,0 +1,172 @@
+#include "HistoryPrefetcher.hpp"
+
+#include "Common.hpp"
+#include "StorageManager.hpp"
+
+#include <QTimer>
+
+#include <algorithm>
+
+HistoryPrefetcher::HistoryPrefetcher(StorageManager *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_client(store->client())
+    , m_idleTimer(new QTimer(this))
+{
+    connect(m_client, SIGNAL(result(td::td_api::Object *)), this, SLOT(handleResult(td::td_api::Object *)));
+    connect(m_idleTimer, SIGNAL(timeout()), this, SLOT(prefetchNext()));
+
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(IdleInterval);
+}
+
+HistoryPrefetcher::Slice HistoryPrefetcher::firstSlice(const td::td_api::chat &chat) noexcept
+{
+    // Unread chats open around the first unread message, the others at the bottom
+    if (chat.unread_count_ > 0)
+        return {chat.last_read_inbox_message_id_, -1 - MessageSliceLimit, 2 * MessageSliceLimit};
+
+    return {chat.last_message_ ? chat.last_message_->id_ : 0, 0, MessageSliceLimit};
+}
+
+void HistoryPrefetcher::setCandidates(const std::vector<qint64> &chatIds)
+{
+    const auto count = std::min<std::size_t>(chatIds.size(), PrefetchChatCount);
+
+    if (std::ranges::equal(chatIds.begin(), chatIds.begin() + count, m_candidates.begin(), m_candidates.end()))
+        return;
+
+    m_candidates.assign(chatIds.begin(), chatIds.begin() + count);
+
+    // Pages of chats that dropped out are not worth their memory
+    const auto dropped = [this](const auto &value) { return std::ranges::find(m_candidates, value.first) == m_candidates.end(); };
+
+    std::erase_if(m_pages, dropped);
+    std::erase_if(m_attempts, dropped);
+
+    m_idleTimer->start();
+}
+
+std::optional<HistoryPrefetcher::Page> HistoryPrefetcher::takePage(qint64 chatId)
+{
+    auto it = m_pages.find(chatId);
+    if (it == m_pages.end())
+        return std::nullopt;
+
+    auto page = std::move(it->second);
+    m_pages.erase(it);
+
+    // A chat read or reopened since then starts from another message
+    const auto *chat = m_store->chat(chatId);
+    if (!chat || firstSlice(*chat).fromMessageId != page.fromMessageId)
+        return std::nullopt;
+
+    return page;
+}
+
+void HistoryPrefetcher::handleResult(td::td_api::Object *object)
+{
+    // New messages only extend a page beyond its slice, anything else may have changed what it holds
+    switch (object->get_id())
+    {
+        case td::td_api::updateDeleteMessages::ID:
+            dropPage(static_cast<const td::td_api::updateDeleteMessages &>(*object).chat_id_);
+            break;
+        case td::td_api::updateMessageContent::ID:
+            dropPage(static_cast<const td::td_api::updateMessageContent &>(*object).chat_id_);
+            break;
+        case td::td_api::updateMessageEdited::ID:
+            dropPage(static_cast<const td::td_api::updateMessageEdited &>(*object).chat_id_);
+            break;
+        case td::td_api::updateMessageIsPinned::ID:
+            dropPage(static_cast<const td::td_api::updateMessageIsPinned &>(*object).chat_id_);
+            break;
+        case td::td_api::updateMessageInteractionInfo::ID:
+            dropPage(static_cast<const td::td_api::updateMessageInteractionInfo &>(*object).chat_id_);
+            break;
+        default:
+            break;
+    }
+}
+
+void HistoryPrefetcher::handlePage(td::td_api::Object *object, qint64 chatId, qint64 fromMessageId)
+{
+    td::td_api::object_ptr<td::td_api::Object> response(object);
+
+    m_inFlight = false;
+
+    if (response->get_id() == td::td_api::messages::ID && std::ranges::find(m_candidates, chatId) != m_candidates.end())
+    {
+        auto result = td::move_tl_object_as<td::td_api::messages>(response);
+
+        Page page{fromMessageId, {}};
+
+        for (auto &message : result->messages_)
+        {
+            if (message)
+                page.messages.emplace_back(std::move(message));
+        }
+
+        if (!page.messages.empty())
+            m_pages.insert_or_assign(chatId, std::move(page));
+    }
+
+    m_idleTimer->start();
+}
+
+void HistoryPrefetcher::prefetchNext()
+{
+    if (m_inFlight)
+        return;
+
+    // Interactive requests go first, the prefetch waits for the client to be idle again
+    if (m_client->pendingRequestCount() > 0)
+    {
+        m_idleTimer->start();
+        return;
+    }
+
+    for (auto chatId : m_candidates)
+    {
+        const auto *chat = m_store->chat(chatId);
+        if (!chat || m_pages.contains(chatId))
+            continue;
+
+        const auto slice = firstSlice(*chat);
+        if (slice.fromMessageId == 0)
+            continue;
+
+        if (auto it = m_attempts.find(chatId); it != m_attempts.end() && it->second == slice.fromMessageId)
+            continue;
+
+        m_attempts[chatId] = slice.fromMessageId;
+
+        auto request = td::td_api::make_object<td::td_api::getChatHistory>();
+        request->chat_id_ = chatId;
+        request->from_message_id_ = slice.fromMessageId;
+        request->offset_ = slice.offset;
+        request->limit_ = slice.limit;
+        request->only_local_ = true;
+
+        m_inFlight = true;
+
+        // Prefetching waits for interactive requests, it must not hold itself up
+        m_client->send(
+            std::move(request),
+            [this, chatId, fromMessageId = slice.fromMessageId](auto &&response) {
+                QMetaObject::invokeMethod(this, "handlePage", Qt::QueuedConnection, Q_ARG(td::td_api::Object *, response.release()), Q_ARG(qint64, chatId),
+                                          Q_ARG(qint64, fromMessageId));
+            },
+            true);
+
+        return;
+    }
+}
+
+void HistoryPrefetcher::dropPage(qint64 chatId)
+{
+    m_attempts.erase(chatId);
+
+    if (m_pages.erase(chatId) > 0)
+        m_idleTimer->start();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <td/telegram/td_api.h>
+
+#include <QObject>
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+class Client;
+class QTimer;
+class StorageManager;
+
+// Warms the first history page of the chats most likely to be opened next while the
+// client is idle, and keeps those pages so that opening such a chat needs no round trip.
+class HistoryPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Slice
+    {
+        qint64 fromMessageId{};
+        qint32 offset{};
+        qint32 limit{};
+    };
+
+    struct Page
+    {
+        qint64 fromMessageId{};
+        std::vector<td::td_api::object_ptr<td::td_api::message>> messages;
+    };
+
+    explicit HistoryPrefetcher(StorageManager *store, QObject *parent = nullptr);
+
+    // The slice a chat is opened with, prefetching exactly that one is what makes a page reusable
+    [[nodiscard]] static Slice firstSlice(const td::td_api::chat &chat) noexcept;
+
+    // Chats in the order they should be warmed, replacing the previous candidates
+    void setCandidates(const std::vector<qint64> &chatIds);
+
+    // Hands over the cached page of a chat, if it is still the chat's first slice
+    [[nodiscard]] std::optional<Page> takePage(qint64 chatId);
+
+private slots:
+    void handleResult(td::td_api::Object *object);
+    void handlePage(td::td_api::Object *object, qint64 chatId, qint64 fromMessageId);
+
+    void prefetchNext();
+
+private:
+    static constexpr auto IdleInterval = 1000;  // msec
+    static constexpr auto PrefetchChatCount = 5;
+
+    void dropPage(qint64 chatId);
+
+    StorageManager *m_store{};
+    Client *m_client{};
+
+    QTimer *m_idleTimer;
+
+    bool m_inFlight = false;
+
+    std::vector<qint64> m_candidates;
+    std::unordered_map<qint64, Page> m_pages;
+
+    // The slice last requested per chat, so that a chat without local history is not asked again
+    std::unordered_map<qint64, qint64> m_attempts;
+};
@@ -0,0 +1,225 @@
+#include "MessageLayouts.hpp"
+
+#include <QFont>
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QList>
+#include <QRunnable>
+#include <QTextLayout>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Keep in sync with the text message delegate in ChatPage.qml and MessageBubble.qml
+constexpr auto FontFamily = "Nokia Pure Text";
+// Keep in sync with the markup of TextFormatter::toHtml
+constexpr auto MonospaceFontFamily = "Courier";
+constexpr auto EmojiFontFamily = "Noto Emoji";
+constexpr auto TextPixelSize = 23;
+constexpr auto SenderPixelSize = 20;
+constexpr auto DatePixelSize = 16;
+
+constexpr std::array<int, 2> TextWidths = {380, 754};
+
+}  // namespace
+
+class MessageLayouts::Job : public QRunnable
+{
+public:
+    Job(MessageLayouts *layouts, int generation, std::vector<Request> &&requests)
+        : m_layouts(layouts)
+        , m_generation(generation)
+        , m_requests(std::move(requests))
+    {
+    }
+
+    void run() override
+    {
+        std::vector<std::pair<qint64, Layout>> result;
+        result.reserve(m_requests.size());
+
+        for (const auto &request : m_requests)
+        {
+            result.emplace_back(request.messageId, compute(request));
+        }
+
+        {
+            std::lock_guard lock(m_layouts->m_mutex);
+            m_layouts->m_ready.emplace_back(m_generation, std::move(result));
+        }
+
+        QMetaObject::invokeMethod(m_layouts, "publish", Qt::QueuedConnection);
+    }
+
+private:
+    MessageLayouts *m_layouts;
+    int m_generation;
+    std::vector<Request> m_requests;
+};
+
+MessageLayouts::MessageLayouts(QObject *parent)
+    : QObject(parent)
+{
+    // A single worker keeps slices in arrival order
+    m_pool.setMaxThreadCount(1);
+}
+
+MessageLayouts::~MessageLayouts()
+{
+    // Jobs refer back to this object
+    m_pool.waitForDone();
+}
+
+void MessageLayouts::layout(std::vector<Request> &&requests)
+{
+    if (requests.empty() || !QFontDatabase::supportsThreadedFontRendering())
+        return;
+
+    m_pool.start(new Job(this, m_generation, std::move(requests)));
+}
+
+const MessageLayouts::Layout *MessageLayouts::find(qint64 messageId) const
+{
+    if (auto it = m_layouts.find(messageId); it != m_layouts.end())
+        return &it->second;
+
+    return nullptr;
+}
+
+void MessageLayouts::retain(qint64 first, qint64 last)
+{
+    std::erase_if(m_layouts, [first, last](const auto &value) { return value.first < first || value.first > last; });
+}
+
+void MessageLayouts::rename(qint64 oldMessageId, qint64 newMessageId)
+{
+    if (auto node = m_layouts.extract(oldMessageId))
+    {
+        node.key() = newMessageId;
+        m_layouts.insert(std::move(node));
+    }
+}
+
+void MessageLayouts::clear()
+{
+    ++m_generation;
+    m_layouts.clear();
+}
+
+std::unordered_map<qint64, MessageLayouts::Layout> MessageLayouts::takeLayouts()
+{
+    ++m_generation;
+    return std::exchange(m_layouts, {});
+}
+
+void MessageLayouts::restore(std::unordered_map<qint64, Layout> &&layouts)
+{
+    m_layouts.merge(layouts);
+}
+
+void MessageLayouts::publish()
+{
+    decltype(m_ready) ready;
+
+    {
+        std::lock_guard lock(m_mutex);
+        ready.swap(m_ready);
+    }
+
+    QList<qint64> messageIds;
+
+    for (auto &[generation, layouts] : ready)
+    {
+        if (generation != m_generation)
+            continue;
+
+        for (auto &[messageId, layout] : layouts)
+        {
+            m_layouts.insert_or_assign(messageId, layout);
+            messageIds.append(messageId);
+        }
+    }
+
+    if (!messageIds.isEmpty())
+        emit layoutsReady(messageIds);
+}
+
+MessageLayouts::Layout MessageLayouts::compute(const Request &request)
+{
+    QFont font(FontFamily);
+    font.setPixelSize(TextPixelSize);
+
+    QList<QTextLayout::FormatRange> formats;
+
+    for (const auto &run : request.text.runs)
+    {
+        QTextLayout::FormatRange range;
+        range.start = run.offset;
+        range.length = run.length;
+
+        if (run.bold)
+            range.format.setFontWeight(QFont::Bold);
+        if (run.italic)
+            range.format.setFontItalic(true);
+        if (run.monospace)
+            range.format.setFontFamily(MonospaceFontFamily);
+        if (run.emoji)
+            range.format.setFontFamily(EmojiFontFamily);
+
+        formats.append(range);
+    }
+
+    // Rich text breaks lines where the text has line breaks, QTextLayout only at line separators
+    auto text = request.text.text;
+    text.replace(QLatin1Char('\n'), QChar(QChar::LineSeparator));
+
+    QTextOption option;
+    option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+
+    Layout result;
+
+    QTextLayout textLayout(text, font);
+    textLayout.setTextOption(option);
+    textLayout.setAdditionalFormats(formats);
+
+    for (auto orientation : {Portrait, Landscape})
+    {
+        qreal width = 0;
+        qreal height = 0;
+
+        textLayout.beginLayout();
+
+        for (auto line = textLayout.createLine(); line.isValid(); line = textLayout.createLine())
+        {
+            line.setLineWidth(TextWidths[orientation]);
+            line.setPosition(QPointF(0, height));
+
+            width = std::max(width, line.naturalTextWidth());
+            height += line.height();
+        }
+
+        textLayout.endLayout();
+
+        result.textWidth[orientation] = static_cast<int>(std::ceil(width));
+        result.textHeight[orientation] = static_cast<int>(std::ceil(height));
+    }
+
+    if (!request.sender.isEmpty())
+    {
+        QFont senderFont(FontFamily);
+        senderFont.setPixelSize(SenderPixelSize);
+        senderFont.setBold(true);
+
+        result.senderWidth = QFontMetrics(senderFont).width(request.sender);
+    }
+
+    QFont dateFont(FontFamily);
+    dateFont.setPixelSize(DatePixelSize);
+    dateFont.setWeight(QFont::Light);
+
+    result.dateWidth = QFontMetrics(dateFont).width(request.date);
+
+    return result;
+}
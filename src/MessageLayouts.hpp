@@ -0,0 +1,83 @@
+#pragma once
+
+#include "TextFormatter.hpp"
+
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#include <array>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Bubble geometry of text messages, laid out on a worker thread as history slices arrive
+// so that delegates are sized without measuring text while the view scrolls.
+class MessageLayouts : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Orientation {
+        Portrait,
+        Landscape,
+    };
+
+    struct Layout
+    {
+        std::array<int, 2> textWidth{};
+        std::array<int, 2> textHeight{};
+        int senderWidth{};
+        int dateWidth{};
+    };
+
+    struct Request
+    {
+        qint64 messageId{};
+        // The text as the delegate shows it, with the runs its rich text sets in other fonts
+        TextFormatter::Plain text;
+        QString sender;
+        QString date;
+    };
+
+    explicit MessageLayouts(QObject *parent = nullptr);
+    ~MessageLayouts() override;
+
+    // Does nothing where fonts cannot be used off the GUI thread, the delegates measure the text then
+    void layout(std::vector<Request> &&requests);
+
+    [[nodiscard]] const Layout *find(qint64 messageId) const;
+
+    // Drops the layouts of messages outside [first, last], as they are no longer loaded
+    void retain(qint64 first, qint64 last);
+    void clear();
+
+    // Keeps the layout of a sent message once it has its final id
+    void rename(qint64 oldMessageId, qint64 newMessageId);
+
+    // Layouts travel with a cached message window and come back when the chat is reopened
+    [[nodiscard]] std::unordered_map<qint64, Layout> takeLayouts();
+    void restore(std::unordered_map<qint64, Layout> &&layouts);
+
+signals:
+    void layoutsReady(const QList<qint64> &messageIds);
+
+private slots:
+    void publish();
+
+private:
+    class Job;
+
+    static Layout compute(const Request &request);
+
+    QThreadPool m_pool;
+
+    // Bumped by clear(), so that layouts of a previous chat are not published
+    int m_generation{};
+
+    std::mutex m_mutex;
+    std::vector<std::pair<int, std::vector<std::pair<qint64, Layout>>>> m_ready;
+
+    std::unordered_map<qint64, Layout> m_layouts;
+};
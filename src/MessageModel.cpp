@@ -2,15 +2,24 @@
 
 #include "Client.hpp"
 #include "Common.hpp"
+#include "HistoryPrefetcher.hpp"
+#include "MessageLayouts.hpp"
+#include "MessageSearchIndex.hpp"
+#include "NavigationIndex.hpp"
+#include "ReadReceipts.hpp"
 #include "StorageManager.hpp"
+#include "TextFormatter.hpp"
+#include "TextFormatterPool.hpp"
 #include "Utils.hpp"
 
 #include <QDateTime>
-#include <QDebug>
 #include <QLocale>
 #include <QTimer>
 
 #include <algorithm>
+#include <iterator>
+#include <limits>
+#include <ranges>
 #include <utility>
 
 namespace {
@@ -182,6 +191,142 @@ QString getUserStatus(const td::td_api::user *user, Locale *locale) noexcept
     }
 }
 
+QString getSendingState(const td::td_api::message &message) noexcept
+{
+    if (!message.sending_state_)
+        return QString();
+
+    return message.sending_state_->get_id() == td::td_api::messageSendingStatePending::ID ? "pending" : "failed";
+}
+
+QString getContentType(const td::td_api::MessageContent &content) noexcept
+{
+    switch (content.get_id())
+    {
+        case td::td_api::messageText::ID:
+            return "messageText";
+        case td::td_api::messageAnimation::ID:
+            return "messageAnimation";
+        case td::td_api::messageAudio::ID:
+            return "messageAudio";
+        case td::td_api::messageDocument::ID:
+            return "messageDocument";
+        case td::td_api::messagePhoto::ID:
+            return "messagePhoto";
+        case td::td_api::messageSticker::ID:
+            return "messageSticker";
+        case td::td_api::messageVideo::ID:
+            return "messageVideo";
+        case td::td_api::messageVideoNote::ID:
+            return "messageVideoNote";
+        case td::td_api::messageVoiceNote::ID:
+            return "messageVoiceNote";
+        case td::td_api::messageLocation::ID:
+            return "messageLocation";
+        case td::td_api::messageContact::ID:
+            return "messageContact";
+        case td::td_api::messagePoll::ID:
+            return "messagePoll";
+        default:
+            return "messageUnsupported";
+    }
+}
+
+QString getEntityType(const td::td_api::TextEntityType &type) noexcept
+{
+    switch (type.get_id())
+    {
+        case td::td_api::textEntityTypeBold::ID:
+            return "textEntityTypeBold";
+        case td::td_api::textEntityTypeItalic::ID:
+            return "textEntityTypeItalic";
+        case td::td_api::textEntityTypeUnderline::ID:
+            return "textEntityTypeUnderline";
+        case td::td_api::textEntityTypeStrikethrough::ID:
+            return "textEntityTypeStrikethrough";
+        case td::td_api::textEntityTypeCode::ID:
+            return "textEntityTypeCode";
+        case td::td_api::textEntityTypePre::ID:
+        case td::td_api::textEntityTypePreCode::ID:
+            return "textEntityTypePre";
+        case td::td_api::textEntityTypeTextUrl::ID:
+            return "textEntityTypeTextUrl";
+        case td::td_api::textEntityTypeUrl::ID:
+            return "textEntityTypeUrl";
+        case td::td_api::textEntityTypeEmailAddress::ID:
+            return "textEntityTypeEmailAddress";
+        case td::td_api::textEntityTypePhoneNumber::ID:
+            return "textEntityTypePhoneNumber";
+        case td::td_api::textEntityTypeMention::ID:
+            return "textEntityTypeMention";
+        case td::td_api::textEntityTypeMentionName::ID:
+            return "textEntityTypeMentionName";
+        case td::td_api::textEntityTypeHashtag::ID:
+            return "textEntityTypeHashtag";
+        case td::td_api::textEntityTypeCashtag::ID:
+            return "textEntityTypeCashtag";
+        case td::td_api::textEntityTypeBotCommand::ID:
+            return "textEntityTypeBotCommand";
+        default:
+            return QString();
+    }
+}
+
+bool isSameSender(const td::td_api::MessageSender &a, const td::td_api::MessageSender &b) noexcept
+{
+    if (a.get_id() != b.get_id())
+        return false;
+
+    if (a.get_id() == td::td_api::messageSenderUser::ID)
+        return static_cast<const td::td_api::messageSenderUser &>(a).user_id_ == static_cast<const td::td_api::messageSenderUser &>(b).user_id_;
+
+    return static_cast<const td::td_api::messageSenderChat &>(a).chat_id_ == static_cast<const td::td_api::messageSenderChat &>(b).chat_id_;
+}
+
+const td::td_api::messageReplyToMessage *getReplyTo(const td::td_api::message &message) noexcept
+{
+    if (!message.reply_to_ || message.reply_to_->get_id() != td::td_api::messageReplyToMessage::ID)
+        return nullptr;
+
+    const auto *replyTo = static_cast<const td::td_api::messageReplyToMessage *>(message.reply_to_.get());
+
+    // Replies to messages in unknown chats carry no id to resolve
+    if (replyTo->chat_id_ == 0 || replyTo->message_id_ == 0)
+        return nullptr;
+
+    return replyTo;
+}
+
+// The JSON shape of formatted text for QML, built per read rather than kept per message
+QVariantMap toVariant(const td::td_api::formattedText &text)
+{
+    QVariantList entities;
+
+    for (const auto &entity : text.entities_)
+    {
+        QVariantMap type;
+        type.insert("@type", getEntityType(*entity->type_));
+
+        if (entity->type_->get_id() == td::td_api::textEntityTypeTextUrl::ID)
+            type.insert("url", QString::fromStdString(static_cast<const td::td_api::textEntityTypeTextUrl &>(*entity->type_).url_));
+        else if (entity->type_->get_id() == td::td_api::textEntityTypeMentionName::ID)
+            type.insert("user_id", static_cast<const td::td_api::textEntityTypeMentionName &>(*entity->type_).user_id_);
+
+        QVariantMap value;
+        value.insert("offset", entity->offset_);
+        value.insert("length", entity->length_);
+        value.insert("type", type);
+
+        entities.append(value);
+    }
+
+    QVariantMap result;
+    result.insert("@type", "formattedText");
+    result.insert("text", QString::fromStdString(text.text_));
+    result.insert("entities", entities);
+    return result;
+}
+
 }  // namespace
 
 MessageModel::MessageModel(QObject *parent)
@@ -192,7 +337,34 @@ MessageModel::MessageModel(QObject *parent)
     m_client = m_storageManager->client();
     m_locale = m_storageManager->locale();
 
-    connect(m_client, SIGNAL(result(const QVariantMap &)), SLOT(handleResult(const QVariantMap &)));
+    m_readReceipts = new ReadReceipts(m_client, this);
+    m_layouts = new MessageLayouts(this);
+    m_formatter = new TextFormatterPool(m_storageManager->richTextCache(), this);
+    m_searchIndex = m_storageManager->messageSearchIndex();
+    m_navigationIndex = m_storageManager->navigationIndex();
+
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(SearchInterval);
+
+    m_frameTimer = new QTimer(this);
+    m_frameTimer->setSingleShot(true);
+    m_frameTimer->setInterval(FrameInterval);
+
+    m_clock.start();
+
+    connect(m_client, SIGNAL(result(td::td_api::Object *)), SLOT(handleResult(td::td_api::Object *)));
+    connect(m_storageManager->chatActionTracker(), SIGNAL(chatActionChanged(qint64)), SLOT(handleChatAction(qint64)));
+
+    connect(m_storageManager->dateBuckets(), SIGNAL(dayChanged(qint32)), SLOT(handleDayChanged(qint32)));
+
+    connect(m_layouts, SIGNAL(layoutsReady(QList<qint64>)), SLOT(handleLayouts(QList<qint64>)));
+    connect(m_formatter, SIGNAL(formattedReady(QList<qint64>)), SLOT(handleRichText(QList<qint64>)));
+    connect(m_searchTimer, SIGNAL(timeout()), SLOT(searchRemote()));
+    connect(m_frameTimer, SIGNAL(timeout()), SLOT(refreshInteractionInfo()));
+    connect(m_navigationIndex, SIGNAL(indexChanged(qint64)), SLOT(handleNavigationIndex(qint64)));
+
+    connect(this, SIGNAL(selectedChatChanged()), SIGNAL(chatSubtitleChanged()));
 
     setRoleNames(roleNames());
 }
@@ -207,31 +379,21 @@ int MessageModel::rowCount(const QModelIndex &parent) const
 
 bool MessageModel::canFetchMore(const QModelIndex &parent) const
 {
-    if (parent.isValid())
+    if (parent.isValid() || m_messages.empty() || m_loading)
         return false;
 
-    if (!m_messages.empty())
-    {
-        if (auto max = std::ranges::max(m_messageIds); max.has_value())
-        {
-            return !m_loading /*&& m_selectedChat->lastMessage()->id() != *max*/;
-        }
-    }
-
-    return false;
+    const auto &lastMessage = m_selectedChat->last_message_;
+    return lastMessage && newestMessageId() < lastMessage->id_;
 }
 
 void MessageModel::fetchMore(const QModelIndex &parent)
 {
-    if (parent.isValid())
+    if (parent.isValid() || m_messages.empty())
         return;
 
     if (!m_loading)
     {
-        if (auto max = std::ranges::max(m_messageIds); max.has_value())
-        {
-            getChatHistory(*max, -MessageSliceLimit, MessageSliceLimit);
-        }
+        requestHistory(m_selectedChat->id_, newestMessageId(), 1 - MessageSliceLimit, MessageSliceLimit, m_evictedNewer, NewerLoad);
 
         m_loading = true;
         emit loadingChanged();
@@ -243,91 +405,150 @@ QVariant MessageModel::data(const QModelIndex &index, int role) const
     if (!index.isValid())
         return QVariant();
 
-    const auto &message = m_messages.at(index.row());
+    // Roles read straight from the td_api object, nested objects are only converted for the delegates that show them
+    const auto row = index.row();
+    const auto &message = *m_messages.at(row);
     switch (role)
     {
         case IdRole:
-            return QString::number(message->id_);
+            return QString::number(message.id_);
         case SenderRole: {
-            if (message->is_outgoing_)
+            if (message.is_outgoing_)
                 return QString();
 
-            return Utils::getTitle(*message, m_storageManager, m_locale);
+            return Utils::getTitle(message, m_storageManager, m_locale);
         }
         case ChatIdRole:
-            return message->chatId();
+            return QString::number(message.chat_id_);
         case SendingStateRole:
-            return message->sendingState();
-        case SchedulingStateRole:
-            return message->schedulingState();
+            return getSendingState(message);
         case IsOutgoingRole:
-            return message->isOutgoing();
+            return message.is_outgoing_;
         case IsPinnedRole:
-            return message->isPinned();
+            return message.is_pinned_;
         case CanBeEditedRole:
-            return message->canBeEdited();
+            return message.can_be_edited_;
         case CanBeForwardedRole:
-            return message->canBeForwarded();
+            return message.can_be_forwarded_;
         case CanBeDeletedOnlyForSelfRole:
-            return message->canBeDeletedOnlyForSelf();
+            return message.can_be_deleted_only_for_self_;
         case CanBeDeletedForAllUsersRole:
-            return message->canBeDeletedForAllUsers();
-        case CanGetStatisticsRole:
-            return message->canGetStatistics();
-        case CanGetMessageThreadRole:
-            return message->canGetMessageThread();
+            return message.can_be_deleted_for_all_users_;
         case IsChannelPostRole:
-            return message->isChannelPost();
+            return message.is_channel_post_;
         case ContainsUnreadMentionRole:
-            return message->containsUnreadMention();
-        case DateRole: {
-            auto date = QDateTime::fromMSecsSinceEpoch(message->date_ * 1000);
-
-            return date.toString(m_locale->getString("formatterDay12H"));
-        }
+            return message.contains_unread_mention_;
+        case DateRole:
+            return QDateTime::fromTime_t(message.date_).toString(m_locale->getString("formatterDay12H"));
         case EditDateRole: {
-            auto date = QDateTime::fromMSecsSinceEpoch(message->editDate() * 1000);
+            if (message.edit_date_ == 0)
+                return QString();
 
-            return date.toString(m_locale->getString("formatterDay12H"));
+            return QDateTime::fromTime_t(message.edit_date_).toString(m_locale->getString("formatterDay12H"));
         }
-        case ForwardInfoRole:
-            return message->forwardInfo();
-        case InteractionInfoRole:
-            return message->interactionInfo();
+        case ViewCountRole:
+            return message.interaction_info_ ? message.interaction_info_->view_count_ : 0;
         case MessageThreadIdRole:
-            return message->messageThreadId();
+            return QString::number(message.message_thread_id_);
         case ViaBotUserIdRole:
-            return message->viaBotUserId();
+            return QString::number(message.via_bot_user_id_);
         case AuthorSignatureRole:
-            return message->authorSignature();
+            return QString::fromStdString(message.author_signature_);
         case MediaAlbumIdRole:
-            return message->mediaAlbumId();
-        case RestrictionReasonRole:
-            return message->restrictionReason();
-        case ContentRole:
-            return message->content();
-        case ReplyMarkupRole:
-            return message->replyMarkup();
+            return QString::number(message.media_album_id_);
+        case ContentTypeRole:
+            return getContentType(*message.content_);
+        case TextRole: {
+            if (message.content_->get_id() != td::td_api::messageText::ID)
+                return QVariant();
+
+            return toVariant(*static_cast<const td::td_api::messageText &>(*message.content_).text_);
+        }
 
         case BubbleColorRole:
             return QVariant();
-        case IsServiceMessageRole: {
-            return Utils::isServiceMessage(message.get());
+        case IsServiceMessageRole:
+            return Utils::isServiceMessage(message);
+        case SectionRole:
+            return m_storageManager->dateBuckets()->section(message.date_);
+        case ServiceMessageRole:
+            return Utils::getServiceMessageContent(message, m_storageManager, m_locale, true);
+        case PortraitTextWidthRole:
+        case PortraitTextHeightRole:
+        case LandscapeTextWidthRole:
+        case LandscapeTextHeightRole:
+        case SenderWidthRole:
+        case DateWidthRole: {
+            const auto *layout = m_layouts->find(message.id_);
+            if (!layout)
+                return 0;
+
+            switch (role)
+            {
+                case PortraitTextWidthRole:
+                    return layout->textWidth[MessageLayouts::Portrait];
+                case PortraitTextHeightRole:
+                    return layout->textHeight[MessageLayouts::Portrait];
+                case LandscapeTextWidthRole:
+                    return layout->textWidth[MessageLayouts::Landscape];
+                case LandscapeTextHeightRole:
+                    return layout->textHeight[MessageLayouts::Landscape];
+                case SenderWidthRole:
+                    return layout->senderWidth;
+                default:
+                    return layout->dateWidth;
+            }
+        }
+        case FirstInGroupRole:
+            return albumBounds(row).first == row;
+        case GroupSizeRole: {
+            const auto [first, last] = albumBounds(row);
+            return last - first + 1;
         }
-        case SectionRole: {
-            const auto date = QDateTime::fromMSecsSinceEpoch(message->date() * 1000);
+        case ShowSenderRole:
+            return row == 0 || !isSameRun(row - 1, row);
+        case ShowAvatarRole:
+            return row + 1 == static_cast<int>(m_messages.size()) || !isSameRun(row, row + 1);
+        case ReplyToRole: {
+            const auto *target = replyTarget(message);
+            if (!target)
+                return QVariant();
+
+            QVariantMap result;
+            result.insert("messageId", QString::number(target->id_));
+            result.insert("sender", Utils::getMessageSenderName(*target, m_storageManager, m_locale));
+            result.insert("text", Utils::getContent(*target, m_storageManager, m_locale));
+            return result;
+        }
+        case RichTextRole: {
+            if (message.content_->get_id() != td::td_api::messageText::ID)
+                return QVariant();
 
-            const auto days = date.daysTo(QDateTime::currentDateTime());
+            auto *cache = m_storageManager->richTextCache();
 
-            if (days == 0)
-                return m_locale->getString("Today");
-            else if (days < 2)
-                return m_locale->getString("Yesterday");
+            const RichTextCache::Key key{message.chat_id_, message.id_, message.edit_date_};
+            if (const auto *text = cache->find(key))
+                return *text;
 
-            return date.toString(m_locale->getString("chatFullDate"));
-        }
-        case ServiceMessageRole: {
-            return Utils::getServiceMessageContent(message.get(), m_storageManager, m_locale, true);
+            auto source = TextFormatter::toSource(*static_cast<const td::td_api::messageText &>(*message.content_).text_);
+
+            // Text with entities is formatted on a worker, until then it is shown the way text without entities is
+            if (!source.entities.empty())
+            {
+                auto text = TextFormatter::toHtml(TextFormatter::Source{source.text, {}});
+
+                // A row scrolled into view goes ahead of the rows a slice queued around it
+                if (m_formatter->isPending(message.id_))
+                    m_formatter->prioritize(message.id_);
+                else
+                    m_formatter->format({{key, std::move(source)}}, true);
+
+                return text;
+            }
+
+            auto text = TextFormatter::toHtml(source);
+            cache->insert(key, text);
+            return text;
         }
     }
     return QVariant();
@@ -340,33 +561,40 @@ QHash<int, QByteArray> MessageModel::roleNames() const noexcept
     roles[SenderRole] = "sender";
     roles[ChatIdRole] = "chatId";
     roles[SendingStateRole] = "sendingState";
-    roles[SchedulingStateRole] = "schedulingState";
     roles[IsOutgoingRole] = "isOutgoing";
     roles[IsPinnedRole] = "isPinned";
     roles[CanBeEditedRole] = "canBeEdited";
     roles[CanBeForwardedRole] = "canBeForwarded";
     roles[CanBeDeletedOnlyForSelfRole] = "canBeDeletedOnlyForSelf";
     roles[CanBeDeletedForAllUsersRole] = "canBeDeletedForAllUsers";
-    roles[CanGetStatisticsRole] = "canGetStatistics";
-    roles[CanGetMessageThreadRole] = "canGetMessageThread";
     roles[IsChannelPostRole] = "isChannelPost";
     roles[ContainsUnreadMentionRole] = "containsUnreadMention";
     roles[DateRole] = "date";
     roles[EditDateRole] = "editDate";
-    roles[ForwardInfoRole] = "forwardInfo";
-    roles[InteractionInfoRole] = "interactionInfo";
+    roles[ViewCountRole] = "viewCount";
     roles[MessageThreadIdRole] = "messageThreadId";
     roles[ViaBotUserIdRole] = "viaBotUserId";
     roles[AuthorSignatureRole] = "authorSignature";
     roles[MediaAlbumIdRole] = "mediaAlbumId";
-    roles[RestrictionReasonRole] = "restrictionReason";
-    roles[ContentRole] = "content";
-    roles[ReplyMarkupRole] = "replyMarkup";
+    roles[ContentTypeRole] = "contentType";
+    roles[TextRole] = "text";
     // Custom
     roles[BubbleColorRole] = "bubbleColor";
     roles[IsServiceMessageRole] = "isServiceMessage";
     roles[SectionRole] = "section";
     roles[ServiceMessageRole] = "serviceMessage";
+    roles[PortraitTextWidthRole] = "portraitTextWidth";
+    roles[PortraitTextHeightRole] = "portraitTextHeight";
+    roles[LandscapeTextWidthRole] = "landscapeTextWidth";
+    roles[LandscapeTextHeightRole] = "landscapeTextHeight";
+    roles[SenderWidthRole] = "senderWidth";
+    roles[DateWidthRole] = "dateWidth";
+    roles[FirstInGroupRole] = "firstInGroup";
+    roles[GroupSizeRole] = "groupSize";
+    roles[ShowSenderRole] = "showSender";
+    roles[ShowAvatarRole] = "showAvatar";
+    roles[ReplyToRole] = "replyTo";
+    roles[RichTextRole] = "richText";
     return roles;
 }
 
@@ -385,17 +613,68 @@ bool MessageModel::loadingHistory() const noexcept
     return m_loadingHistory;
 }
 
+int MessageModel::windowSize() const noexcept
+{
+    return m_windowSize;
+}
+
+void MessageModel::setWindowSize(int value)
+{
+    value = std::max(value, 2 * MessageSliceLimit);
+
+    if (m_windowSize != value)
+    {
+        m_windowSize = value;
+        emit windowSizeChanged();
+
+        evictMessages();
+    }
+}
+
+QVariantList MessageModel::searchResults() const noexcept
+{
+    return m_searchResults;
+}
+
+int MessageModel::pinnedMessageCount() const noexcept
+{
+    return m_selectedChat ? m_navigationIndex->pinnedCount(m_selectedChat->id_) : 0;
+}
+
 QString MessageModel::getChatId() const noexcept
 {
+    if (!m_selectedChat)
+        return {};
+
     return QString::number(m_selectedChat->id_);
 }
 
 void MessageModel::setChatId(const QString &value) noexcept
 {
-    if (QString::number(m_selectedChat->id_) != value)
+    if (!m_selectedChat || QString::number(m_selectedChat->id_) != value)
     {
         m_selectedChat = m_storageManager->chat(value.toLongLong());
+        m_layouts->clear();
+        m_formatter->clear();
+
+        m_replies.clear();
+        m_pendingReplies.clear();
+
+        m_interactionChanged.clear();
+        m_interactionStale.clear();
+
+        m_mentionJumpId = 0;
+        m_pinnedJumpId = 0;
+
+        // Message ids of another chat can match rows of this one, which would then be viewed, kept and formatted first
+        m_viewportFirstId = 0;
+        m_viewportLastId = 0;
+        m_pendingJumpId = 0;
+
+        clearSearch();
+
         emit selectedChatChanged();
+        emit pinnedMessageCountChanged();
     }
 }
 
@@ -404,6 +683,10 @@ QString MessageModel::getChatSubtitle() const noexcept
     if (!m_selectedChat)
         return {};
 
+    // An ongoing chat action replaces the status, as in the chat list
+    if (auto action = m_storageManager->chatActionTracker()->summary(m_selectedChat->id_); !action.isEmpty())
+        return action;
+
     switch (m_selectedChat->type_->get_id())
     {
         case td::td_api::chatTypePrivate::ID:
@@ -447,7 +730,7 @@ QString MessageModel::getChatTitle() const noexcept
 QString MessageModel::getChatPhoto() const noexcept
 {
     if (!m_selectedChat)
-        return;
+        return {};
 
     if (const auto &chatPhoto = m_selectedChat->photo_; chatPhoto)
     {
@@ -465,26 +748,140 @@ QString MessageModel::getChatPhoto() const noexcept
 
 void MessageModel::loadHistory() noexcept
 {
-    if (m_messageIds.empty())
+    if (m_messages.empty() || m_loadingHistory)
+        return;
+
+    m_loadingHistory = true;
+
+    requestHistory(m_selectedChat->id_, oldestMessageId(), 0, MessageSliceLimit, m_evictedOlder, OlderLoad);
+
+    emit loadingChanged();
+}
+
+void MessageModel::setViewport(int firstRow, int lastRow)
+{
+    if (firstRow < 0 || lastRow < firstRow || lastRow >= static_cast<int>(m_messages.size()))
+        return;
+
+    // Ids rather than rows, as rows move with every insertion above the viewport
+    m_viewportFirstId = m_messages[firstRow]->id_;
+    m_viewportLastId = m_messages[lastRow]->id_;
+
+    // Counters that changed while off screen are shown as their rows come into view
+    std::erase_if(m_interactionStale, [this](auto messageId) {
+        if (messageId < m_viewportFirstId || messageId > m_viewportLastId)
+            return rowOf(messageId) < 0;
+
+        m_interactionChanged.insert(messageId);
+        return true;
+    });
+
+    if (!m_interactionChanged.empty() && !m_frameTimer->isActive())
+        m_frameTimer->start();
+
+    viewVisibleMessages();
+    evictMessages();
+    fillGaps();
+}
+
+void MessageModel::jumpToMessage(qint64 messageId)
+{
+    if (!m_selectedChat)
+        return;
+
+    m_viewportFirstId = m_viewportLastId = messageId;
+
+    if (const auto row = rowOf(messageId); row >= 0)
     {
-        qDebug() << "No messages available to load history.";
+        emit anchorRequested(row);
         return;
     }
 
-    if (auto min = std::ranges::min(m_messageIds); min.has_value() && !m_loadingHistory)
+    // Only the slice around the target is loaded, it stays a separate range until scrolling closes the gap
+    m_pendingJumpId = messageId;
+    m_loadingGap = true;
+
+    requestHistory(m_selectedChat->id_, messageId, -MessageSliceLimit / 2, MessageSliceLimit, false, GapLoad);
+}
+
+bool MessageModel::jumpToNextMention()
+{
+    if (!m_selectedChat)
+        return false;
+
+    const auto messageId = m_navigationIndex->nextMention(m_selectedChat->id_, m_mentionJumpId);
+    if (messageId == 0)
     {
-        qDebug() << "Loading history starting from message ID:" << *min;
+        m_navigationIndex->load(m_selectedChat->id_);
+        return false;
+    }
 
-        m_loadingHistory = true;
+    m_mentionJumpId = messageId;
+    jumpToMessage(messageId);
+    return true;
+}
 
-        getChatHistory(*min, 0, MessageSliceLimit);
+bool MessageModel::jumpToNextPinned()
+{
+    if (!m_selectedChat)
+        return false;
 
-        emit loadingChanged();
+    // Pinned messages are stepped through from the newest one back
+    const auto messageId =
+        m_navigationIndex->nextPinned(m_selectedChat->id_, m_pinnedJumpId != 0 ? m_pinnedJumpId : std::numeric_limits<qint64>::max());
+    if (messageId == 0)
+    {
+        m_navigationIndex->load(m_selectedChat->id_);
+        return false;
     }
-    else
+
+    m_pinnedJumpId = messageId;
+    jumpToMessage(messageId);
+    return true;
+}
+
+void MessageModel::searchMessages(const QString &query)
+{
+    if (!m_selectedChat)
+        return;
+
+    m_searchTimer->stop();
+    m_searchQuery = query.trimmed();
+    m_searchResults.clear();
+
+    if (!m_searchQuery.isEmpty())
     {
-        qDebug() << "No minimum message ID found or already loading history.";
+        for (auto messageId : m_searchIndex->search(m_selectedChat->id_, m_searchQuery, MessageSearchLimit))
+        {
+            m_searchResults.append(messageId);
+        }
+
+        // Typing goes on while the local results show, TDLib is only asked once it pauses
+        if (m_searchResults.size() < MessageSearchLimit)
+            m_searchTimer->start();
     }
+
+    emit searchResultsChanged();
+}
+
+QVariantMap MessageModel::metrics() const
+{
+    QVariantMap result;
+    result.insert("historyRequests", m_historyRequests.load());
+    result.insert("loadedRanges", m_ranges.size());
+    result.insert("rows", static_cast<int>(m_messages.size()));
+    result.insert("readReceiptReports", m_readReceipts->reportCount());
+    result.insert("readReceiptRequests", m_readReceipts->requestCount());
+    result.insert("readReceiptRequestsAvoided", m_readReceipts->avoidedRequestCount());
+    result.insert("richTextCacheHits", m_storageManager->richTextCache()->hitCount());
+    result.insert("richTextCacheMisses", m_storageManager->richTextCache()->missCount());
+    result.insert("pendingSends", static_cast<int>(m_sendQueue.size() + m_pendingSends.size()));
+    result.insert("failedSends", m_failedSendCount);
+    result.insert("lastSendLatency", m_lastSendLatency);
+    result.insert("averageSendLatency", m_sentCount > 0 ? m_totalSendLatency / m_sentCount : 0);
+    // A rate of a window that ended more than a second ago no longer holds
+    result.insert("interactionUpdatesPerSecond", m_clock.elapsed() - m_interactionWindowStart < 2000 ? m_interactionRate : 0);
+    return result;
 }
 
 void MessageModel::openChat() noexcept
@@ -494,6 +891,9 @@ void MessageModel::openChat() noexcept
 
     m_client->send(td::td_api::make_object<td::td_api::openChat>(m_selectedChat->id_), {});
 
+    m_searchIndex->setBackfillChat(m_selectedChat->id_);
+    m_navigationIndex->load(m_selectedChat->id_);
+
     loadMessages();
 }
 
@@ -502,6 +902,34 @@ void MessageModel::closeChat() noexcept
     if (!m_selectedChat)
         return;
 
+    // Whatever has been seen until now still counts as read
+    m_readReceipts->flush();
+    m_readReceipts->forget(m_selectedChat->id_);
+
+    m_searchIndex->setBackfillChat(0);
+    m_searchIndex->flush(m_selectedChat->id_);
+
+    clearSearch();
+
+    if (!m_messages.empty())
+    {
+        MessagePageCache::Window window;
+        window.ranges = m_ranges;
+        window.layouts = m_layouts->takeLayouts();
+        window.viewportFirstId = m_viewportFirstId;
+        window.viewportLastId = m_viewportLastId;
+
+        beginResetModel();
+        window.messages = std::move(m_messages);
+        m_messages.clear();
+        m_ranges.clear();
+        endResetModel();
+
+        emit countChanged();
+
+        m_storageManager->messagePageCache()->put(m_selectedChat->id_, std::move(window));
+    }
+
     m_client->send(td::td_api::make_object<td::td_api::closeChat>(m_selectedChat->id_), {});
 }
 
@@ -510,18 +938,7 @@ void MessageModel::getChatHistory(qint64 fromMessageId, qint32 offset, qint32 li
     if (!m_selectedChat)
         return;
 
-    auto request = td::td_api::make_object<td::td_api::getChatHistory>();
-
-    request->chat_id_ = m_selectedChat->id_;
-    request->from_message_id_ = fromMessageId;
-    request->offset_ = offset;
-    request->limit_ = limit;
-    request->only_local_ = false;
-
-    m_client->send(std::move(request), [this](auto &&response) {
-        if (response->get_id() == td::td_api::messages::ID)
-            handleMessages(td::move_tl_object_as<td::td_api::messages>(response));
-    });
+    requestHistory(m_selectedChat->id_, fromMessageId, offset, limit, false, GapLoad);
 }
 
 void MessageModel::sendMessage(const QString &message, qint64 replyToMessageId)
@@ -529,25 +946,9 @@ void MessageModel::sendMessage(const QString &message, qint64 replyToMessageId)
     if (!m_selectedChat)
         return;
 
-    QVariantMap formattedText, inputMessageContent;
-    formattedText.insert("@type", "formattedText");
-    formattedText.insert("text", message);
-
-    inputMessageContent.insert("@type", "inputMessageText");
-    inputMessageContent.insert("text", formattedText);
+    m_sendQueue.push_back({m_selectedChat->id_, message, replyToMessageId, m_clock.elapsed()});
 
-    QVariantMap request;
-    request.insert("@type", "sendMessage");
-    request.insert("chat_id", m_selectedChat->id());
-
-    if (replyToMessageId != 0)
-    {
-        request.insert("reply_to_message_id", replyToMessageId);
-    }
-
-    request.insert("input_message_content", inputMessageContent);
-
-    m_client->send(request);
+    sendNext();
 }
 
 void MessageModel::viewMessages(const QVariantList &messageIds)
@@ -555,14 +956,15 @@ void MessageModel::viewMessages(const QVariantList &messageIds)
     if (!m_selectedChat)
         return;
 
-    QVariantMap request;
-    request.insert("@type", "viewMessages");
-    request.insert("chat_id", m_selectedChat->id());
-    request.insert("message_thread_id", 0);
-    request.insert("message_ids", messageIds);
-    request.insert("force_read", true);
+    std::vector<std::int64_t> ids;
+    ids.reserve(messageIds.size());
+
+    for (const auto &value : messageIds)
+    {
+        ids.emplace_back(value.toLongLong());
+    }
 
-    m_client->send(request);
+    m_readReceipts->add(m_selectedChat->id_, ids);
 }
 
 void MessageModel::deleteMessage(qint64 messageId, bool revoke) noexcept
@@ -570,26 +972,39 @@ void MessageModel::deleteMessage(qint64 messageId, bool revoke) noexcept
     if (!m_selectedChat)
         return;
 
-    QVariantMap request;
-    request.insert("@type", "deleteMessages");
-    request.insert("chat_id", m_selectedChat->id());
-    request.insert("message_ids", QVariantList() << messageId);
-    request.insert("revoke", revoke);
+    auto request = td::td_api::make_object<td::td_api::deleteMessages>();
+    request->chat_id_ = m_selectedChat->id_;
+    request->message_ids_.emplace_back(messageId);
+    request->revoke_ = revoke;
 
-    m_client->send(request);
+    m_client->send(std::move(request), {});
 }
 
 void MessageModel::refresh() noexcept
 {
+    m_viewportFirstId = 0;
+    m_viewportLastId = 0;
+    m_pendingJumpId = 0;
+
     if (m_messages.empty())
         return;
 
-    m_loading = true;
-    m_loadingHistory = true;
+    m_loading = false;
+    m_loadingHistory = false;
+    m_loadingGap = false;
+    m_evictedOlder = false;
+    m_evictedNewer = false;
+    m_pendingJumpId = 0;
 
     beginResetModel();
+    m_ranges.clear();
+    m_layouts->clear();
+    m_formatter->clear();
     m_messages.clear();
-    m_messageIds.clear();
+    m_replies.clear();
+    m_pendingReplies.clear();
+    m_interactionChanged.clear();
+    m_interactionStale.clear();
     endResetModel();
 
     emit countChanged();
@@ -597,337 +1012,1131 @@ void MessageModel::refresh() noexcept
 
 void MessageModel::handleResult(td::td_api::Object *object)
 {
-    static const std::unordered_map<QString, std::function<void(const QVariantMap &)>> handlers = {
-        {"updateNewMessage", [this](const QVariantMap &obj) { handleNewMessage(obj.value("message").toMap()); }},
-        {"updateMessageSendSucceeded",
-         [this](const QVariantMap &obj) { handleMessageSendSucceeded(obj.value("message").toMap(), obj.value("old_message_id").toLongLong()); }},
-        {"updateMessageSendFailed",
-         [this](const QVariantMap &obj) {
-             handleMessageSendFailed(obj.value("message").toMap(), obj.value("old_message_id").toLongLong(), obj.value("error_code").toInt(),
-                                     obj.value("error_message").toString());
-         }},
-        {"updateMessageContent",
-         [this](const QVariantMap &obj) {
-             handleMessageContent(obj.value("chat_id").toLongLong(), obj.value("message_id").toLongLong(), obj.value("new_content").toMap());
-         }},
-        {"updateMessageEdited",
-         [this](const QVariantMap &obj) {
-             handleMessageEdited(obj.value("chat_id").toLongLong(), obj.value("message_id").toLongLong(), obj.value("edit_date").toInt(),
-                                 obj.value("reply_markup").toMap());
-         }},
-        {"updateMessageIsPinned",
-         [this](const QVariantMap &obj) {
-             handleMessageIsPinned(obj.value("chat_id").toLongLong(), obj.value("message_id").toLongLong(), obj.value("is_pinned").toBool());
-         }},
-        {"updateMessageInteractionInfo",
-         [this](const QVariantMap &obj) {
-             handleMessageInteractionInfo(obj.value("chat_id").toLongLong(), obj.value("message_id").toLongLong(), obj.value("interaction_info").toMap());
-         }},
-        {"updateChatOnlineMemberCount",
-         [this](const QVariantMap &obj) { handleChatOnlineMemberCount(obj.value("chat_id").toLongLong(), obj.value("online_member_count").toInt()); }},
-        {"updateChatReadInbox",
-         [this](const QVariantMap &obj) {
-             handleChatReadInbox(obj.value("chat_id").toLongLong(), obj.value("last_read_inbox_message_id").toLongLong(), obj.value("online_count").toInt());
-         }},
-        {"updateChatReadOutbox",
-         [this](const QVariantMap &obj) { handleChatReadOutbox(obj.value("chat_id").toLongLong(), obj.value("last_read_outbox_message_id").toLongLong()); }},
-    };
-
-    if (const auto it = handlers.find(object.value("@type").toString()); it != handlers.end())
-    {
-        it->second(object);
-    }
+    td::td_api::downcast_call(
+        *object, detail::Overloaded{
+                     [this](td::td_api::updateNewMessage &value) { handleNewMessage(std::move(value.message_)); },
+                     [this](td::td_api::updateMessageSendSucceeded &value) { handleMessageSendSucceeded(std::move(value.message_), value.old_message_id_); },
+                     [this](td::td_api::updateMessageSendFailed &value) { handleMessageSendFailed(std::move(value.message_), value.old_message_id_); },
+                     [this](td::td_api::updateMessageContent &value) {
+                         handleMessageContent(value.chat_id_, value.message_id_, std::move(value.new_content_));
+                     },
+                     [this](td::td_api::updateMessageEdited &value) {
+                         handleMessageEdited(value.chat_id_, value.message_id_, value.edit_date_, std::move(value.reply_markup_));
+                     },
+                     [this](td::td_api::updateMessageIsPinned &value) { handleMessageIsPinned(value.chat_id_, value.message_id_, value.is_pinned_); },
+                     [this](td::td_api::updateMessageInteractionInfo &value) {
+                         handleMessageInteractionInfo(value.chat_id_, value.message_id_, std::move(value.interaction_info_));
+                     },
+                     [this](td::td_api::updateDeleteMessages &value) {
+                         if (!value.from_cache_)
+                             handleDeleteMessages(value.chat_id_, value.message_ids_);
+                     },
+                     [this](td::td_api::updateChatOnlineMemberCount &value) { handleChatOnlineMemberCount(value.chat_id_, value.online_member_count_); },
+                     [this](td::td_api::updateChatReadInbox &value) { handleChatReadInbox(value.chat_id_); },
+                     [this](td::td_api::updateChatReadOutbox &value) { handleChatReadOutbox(value.chat_id_); },
+                     [](auto &) {}});
 }
 
-void MessageModel::handleNewMessage(const QVariantMap &message)
+void MessageModel::handleMessages(td::td_api::Object *object, qint64 fromMessageId, int load)
 {
-    if (!m_selectedChat)
-        return;
+    td::td_api::object_ptr<td::td_api::Object> response(object);
 
-    if (m_selectedChat->id() != message.value("chat_id").toLongLong())
-        return;
+    std::vector<MessagePtr> messages;
 
-    if (auto lastMessage = m_selectedChat->lastMessage(); m_messageIds.contains(lastMessage->id()))
+    if (response->get_id() == td::td_api::messages::ID)
     {
-        beginInsertRows(QModelIndex(), rowCount(), rowCount());
+        auto result = td::move_tl_object_as<td::td_api::messages>(response);
+
+        // A reply for a chat that has been closed in the meantime
+        for (auto &message : result->messages_)
+        {
+            if (message && isSelectedChat(message->chat_id_))
+                messages.emplace_back(std::move(message));
+        }
+    }
 
-        auto newMessage = std::make_unique<Message>();
-        newMessage->setFromVariantMap(message);
+    const auto rangeCount = m_ranges.size();
 
-        auto id = newMessage->id();
-        m_messageIds.insert(id);
+    // Every reply is one contiguous slice of history that reaches the message it was requested from.
+    // A restored window brings its own ranges.
+    if (!messages.empty() && load != RestoreLoad)
+    {
+        const auto [minimum, maximum] = std::ranges::minmax(messages | std::views::transform([](const auto &message) { return message->id_; }));
 
-        m_messages.push_back(std::move(newMessage));
+        const auto first = fromMessageId != 0 ? std::min(minimum, fromMessageId) : minimum;
+        const auto last = fromMessageId != 0 ? std::max(maximum, fromMessageId) : maximum;
 
-        endInsertRows();
+        m_ranges.insert(first, last);
 
-        viewMessages(QVariantList() << id);
+        std::vector<const td::td_api::message *> indexed;
+        indexed.reserve(messages.size());
 
-        emit countChanged();
+        for (const auto &message : messages)
+        {
+            indexed.push_back(message.get());
+        }
+
+        m_searchIndex->addMessages(m_selectedChat->id_, indexed, first, last);
     }
-}
 
-void MessageModel::handleMessageSendSucceeded(const QVariantMap &message, qint64 oldMessageId)
-{
-}
+    const auto count = insertMessages(std::move(messages));
 
-void MessageModel::handleMessageSendFailed(const QVariantMap &message, qint64 oldMessageId, int errorCode, const QString &errorMessage)
-{
-}
+    switch (load)
+    {
+        case OlderLoad:
+            m_loadingHistory = false;
+            emit moreHistoriesLoaded(count);
+            break;
+        case NewerLoad:
+            m_loading = false;
+            break;
+        case GapLoad:
+            m_loadingGap = false;
 
-void MessageModel::handleMessageContent(qint64 chatId, qint64 messageId, const QVariantMap &newContent)
-{
-    if (!m_selectedChat)
-        return;
+            if (const auto row = rowOf(m_pendingJumpId); m_pendingJumpId != 0 && row >= 0)
+                emit anchorRequested(row);
 
-    if (chatId != m_selectedChat->id())
-        return;
+            m_pendingJumpId = 0;
+            break;
+        case RestoreLoad:
+            m_loading = false;
 
-    auto it = std::ranges::find_if(m_messages, [messageId](const auto &message) { return message->id() == messageId; });
+            if (const auto row = rowOf(m_pendingJumpId); m_pendingJumpId != 0 && row >= 0)
+                emit anchorRequested(row);
 
-    if (it != m_messages.end())
-    {
-        (*it)->setContent(newContent);
+            m_pendingJumpId = 0;
 
-        auto index = std::distance(m_messages.begin(), it);
-        itemChanged(index);
+            // The delta since the chat was closed, any gap it leaves is closed as the viewport reaches it
+            if (m_selectedChat && m_selectedChat->last_message_ && m_selectedChat->last_message_->id_ > newestMessageId())
+            {
+                m_loading = true;
+                requestHistory(m_selectedChat->id_, m_selectedChat->last_message_->id_, 0, MessageSliceLimit, false, NewerLoad);
+            }
+            break;
     }
-}
 
-void MessageModel::handleMessageEdited(qint64 chatId, qint64 messageId, int editDate, const QVariantMap &replyMarkup)
-{
-    if (!m_selectedChat)
-        return;
+    emit loadingChanged();
 
-    if (chatId != m_selectedChat->id())
-        return;
+    // A filled gap may have put new rows between the viewport bounds
+    if (count > 0)
+        viewVisibleMessages();
 
-    if (auto it = std::ranges::find_if(m_messages, [messageId](const auto &message) { return message->id() == messageId; }); it != m_messages.end())
-    {
-        (*it)->setEditDate(editDate);
-        (*it)->setReplyMarkup(replyMarkup);
+    evictMessages();
 
-        auto index = std::distance(m_messages.begin(), it);
-        itemChanged(index);
-    }
+    // Keep closing gaps only while replies make progress, a gap of deleted messages never fills
+    if (count > 0 || m_ranges.size() != rangeCount)
+        fillGaps();
 }
 
-void MessageModel::handleMessageIsPinned(qint64 chatId, qint64 messageId, bool isPinned)
+void MessageModel::handleNewMessage(MessagePtr &&message)
 {
-    if (!m_selectedChat)
-        return;
-
-    if (chatId != m_selectedChat->id())
+    if (!isSelectedChat(message->chat_id_))
         return;
 
-    if (auto it = std::ranges::find_if(m_messages, [messageId](const auto &message) { return message->id() == messageId; }); it != m_messages.end())
+    // Only append when the loaded rows already reach the end of the chat
+    if (const auto &lastMessage = m_selectedChat->last_message_; lastMessage && rowOf(lastMessage->id_) >= 0)
     {
-        (*it)->setIsPinned(isPinned);
+        const auto id = message->id_;
 
-        auto index = std::distance(m_messages.begin(), it);
-        itemChanged(index);
-    }
-}
+        // A viewport resting on the newest row follows the chat as it grows
+        const auto following = m_viewportLastId != 0 && m_viewportLastId == newestMessageId();
 
-void MessageModel::handleMessageInteractionInfo(qint64 chatId, qint64 messageId, const QVariantMap &interactionInfo)
-{
-    if (!m_selectedChat)
-        return;
+        m_ranges.insert(lastMessage->id_, id);
 
-    if (chatId != m_selectedChat->id())
-        return;
+        // Messages being sent are indexed under their final id
+        if (!message->sending_state_)
+            m_searchIndex->addMessages(message->chat_id_, {message.get()}, lastMessage->id_, id);
 
-    if (auto it = std::ranges::find_if(m_messages, [messageId](const auto &message) { return message->id() == messageId; }); it != m_messages.end())
-    {
-        (*it)->setInteractionInfo(interactionInfo);
+        std::vector<MessagePtr> messages;
+        messages.emplace_back(std::move(message));
 
-        auto index = std::distance(m_messages.begin(), it);
-        itemChanged(index);
+        insertMessages(std::move(messages));
+
+        if (following)
+        {
+            m_viewportLastId = id;
+            viewVisibleMessages();
+        }
     }
 }
 
-void MessageModel::handleDeleteMessages(qint64 chatId, const QVariantList &messageIds, bool isPermanent, bool fromCache)
+void MessageModel::handleMessageSendSucceeded(MessagePtr &&message, qint64 oldMessageId)
 {
-    if (!m_selectedChat)
-        return;
-
-    if (chatId != m_selectedChat->id())
-        return;
-
-    for (const auto &value : messageIds)
+    if (auto it = m_pendingSends.find(oldMessageId); it != m_pendingSends.end())
     {
-        auto messageId = value.toLongLong();
-        if (auto it = std::ranges::find_if(m_messages, [messageId](const auto &message) { return message->id() == messageId; }); it != m_messages.end())
-        {
-            auto index = std::distance(m_messages.begin(), it);
+        m_lastSendLatency = m_clock.elapsed() - it->second;
+        m_totalSendLatency += m_lastSendLatency;
+        ++m_sentCount;
 
-            beginRemoveRows(QModelIndex(), index, index);
-            m_messages.erase(it);
-            endRemoveRows();
-        }
+        m_pendingSends.erase(it);
     }
+
+    replaceSentMessage(std::move(message), oldMessageId);
 }
 
-void MessageModel::handleChatOnlineMemberCount(qint64 chatId, int onlineMemberCount)
+void MessageModel::handleMessageSendFailed(MessagePtr &&message, qint64 oldMessageId)
 {
-    if (!m_selectedChat)
+    if (m_pendingSends.erase(oldMessageId) > 0)
+        ++m_failedSendCount;
+
+    replaceSentMessage(std::move(message), oldMessageId);
+}
+
+void MessageModel::replaceSentMessage(MessagePtr &&message, qint64 oldMessageId)
+{
+    const auto row = rowOf(oldMessageId);
+    if (!isSelectedChat(message->chat_id_) || row < 0)
         return;
 
-    if (chatId == m_selectedChat->id())
+    const auto id = message->id_;
+
+    m_ranges.insert(oldMessageId, id);
+
+    if (!message->sending_state_)
+        m_searchIndex->addMessages(message->chat_id_, {message.get()}, oldMessageId, id);
+
+    // Nothing arrived between the temporary and the final id, so the row keeps its place and only its roles change
+    const auto size = static_cast<int>(m_messages.size());
+    if ((row == 0 || m_messages[row - 1]->id_ < id) && (row + 1 == size || m_messages[row + 1]->id_ > id))
     {
-        m_onlineCount = onlineMemberCount;
+        m_layouts->rename(oldMessageId, id);
 
-        emit selectedChatChanged();
+        if (m_viewportFirstId == oldMessageId)
+            m_viewportFirstId = id;
+        if (m_viewportLastId == oldMessageId)
+            m_viewportLastId = id;
+
+        m_messages[row] = std::move(message);
+        itemChanged(row);
+        return;
     }
+
+    removeMessages({oldMessageId});
+
+    std::vector<MessagePtr> messages;
+    messages.emplace_back(std::move(message));
+
+    insertMessages(std::move(messages));
 }
 
-void MessageModel::handleChatReadInbox(qint64 chatId, qint64 lastReadInboxMessageId, int unreadCount)
+void MessageModel::sendNext()
 {
-    if (!m_selectedChat)
+    if (m_sending || m_sendQueue.empty())
         return;
 
-    if (chatId == m_selectedChat->id())
+    auto outgoing = std::move(m_sendQueue.front());
+    m_sendQueue.pop_front();
+
+    auto formattedText = td::td_api::make_object<td::td_api::formattedText>();
+    formattedText->text_ = outgoing.text.toStdString();
+
+    auto inputMessageContent = td::td_api::make_object<td::td_api::inputMessageText>();
+    inputMessageContent->text_ = std::move(formattedText);
+
+    auto request = td::td_api::make_object<td::td_api::sendMessage>();
+    request->chat_id_ = outgoing.chatId;
+
+    if (outgoing.replyToMessageId != 0)
     {
-        m_selectedChat->setLastReadInboxMessageId(lastReadInboxMessageId);
-        m_selectedChat->setUnreadCount(unreadCount);
+        auto replyTo = td::td_api::make_object<td::td_api::inputMessageReplyToMessage>();
+        replyTo->message_id_ = outgoing.replyToMessageId;
 
-        emit selectedChatChanged();
+        request->reply_to_ = std::move(replyTo);
     }
+
+    request->input_message_content_ = std::move(inputMessageContent);
+
+    m_sending = true;
+
+    m_client->send(std::move(request), [this, tappedAt = outgoing.tappedAt](auto &&response) {
+        QMetaObject::invokeMethod(this, "handleMessageSent", Qt::QueuedConnection, Q_ARG(td::td_api::Object *, response.release()),
+                                  Q_ARG(qint64, tappedAt));
+    });
 }
 
-void MessageModel::handleChatReadOutbox(qint64 chatId, qint64 lastReadOutboxMessageId)
+void MessageModel::handleMessageSent(td::td_api::Object *object, qint64 tappedAt)
 {
-    if (!m_selectedChat)
+    td::td_api::object_ptr<td::td_api::Object> response(object);
+
+    m_sending = false;
+
+    if (response->get_id() == td::td_api::message::ID)
+    {
+        auto message = td::move_tl_object_as<td::td_api::message>(response);
+
+        // Messages to the saved messages chat and scheduled ones never wait for the server
+        if (message->sending_state_ && message->sending_state_->get_id() == td::td_api::messageSendingStatePending::ID)
+            m_pendingSends.emplace(message->id_, tappedAt);
+
+        // The pending row shows now, updateNewMessage for it only refreshes the row
+        handleNewMessage(std::move(message));
+    }
+    else
+    {
+        ++m_failedSendCount;
+    }
+
+    sendNext();
+}
+
+void MessageModel::handleMessageContent(qint64 chatId, qint64 messageId, td::td_api::object_ptr<td::td_api::MessageContent> &&newContent)
+{
+    if (const auto row = isSelectedChat(chatId) ? rowOf(messageId) : -1; row >= 0)
+    {
+        // updateMessageEdited with the new edit date may come later, the old version must not be served until then
+        m_storageManager->richTextCache()->remove({chatId, messageId, m_messages[row]->edit_date_});
+        m_formatter->forget(messageId);
+
+        m_messages[row]->content_ = std::move(newContent);
+        itemChanged(row);
+
+        layoutMessages({m_messages[row].get()});
+        formatMessages({m_messages[row].get()});
+    }
+    else if (auto it = m_replies.find({chatId, messageId}); it != m_replies.end() && it->second)
+    {
+        it->second->content_ = std::move(newContent);
+    }
+    else
+    {
+        return;
+    }
+
+    replyTargetChanged(chatId, messageId);
+}
+
+void MessageModel::handleMessageEdited(qint64 chatId, qint64 messageId, int editDate, td::td_api::object_ptr<td::td_api::ReplyMarkup> &&replyMarkup)
+{
+    if (!isSelectedChat(chatId))
         return;
 
-    if (chatId != m_selectedChat->id())
+    if (const auto row = rowOf(messageId); row >= 0)
     {
-        m_selectedChat->setLastReadOutboxMessageId(lastReadOutboxMessageId);
+        // The rich text of the current content, cached or still being formatted, is kept under the new version
+        m_storageManager->richTextCache()->rename({chatId, messageId, m_messages[row]->edit_date_}, {chatId, messageId, editDate});
+        m_formatter->setEditDate(messageId, editDate);
 
-        emit selectedChatChanged();
+        m_messages[row]->edit_date_ = editDate;
+        m_messages[row]->reply_markup_ = std::move(replyMarkup);
+        itemChanged(row);
     }
 }
 
-void MessageModel::handleMessages(td::td_api::object_ptr<td::td_api::messages> &&messages)
+void MessageModel::handleMessageIsPinned(qint64 chatId, qint64 messageId, bool isPinned)
 {
-    auto list = messages.value("messages").toList();
+    if (!isSelectedChat(chatId))
+        return;
 
-    std::vector<std::unique_ptr<Message>> result;
+    if (const auto row = rowOf(messageId); row >= 0)
+    {
+        m_messages[row]->is_pinned_ = isPinned;
+        itemChanged(row);
+    }
+}
 
-    result.reserve(list.size());
+void MessageModel::handleMessageInteractionInfo(qint64 chatId, qint64 messageId, td::td_api::object_ptr<td::td_api::messageInteractionInfo> &&interactionInfo)
+{
+    if (!isSelectedChat(chatId))
+        return;
+
+    ++m_interactionUpdates;
 
-    for (const auto &value : list)
+    if (const auto elapsed = m_clock.elapsed() - m_interactionWindowStart; elapsed >= 1000)
     {
-        auto message = std::make_unique<Message>();
-        message->setFromVariantMap(value.toMap());
-        result.push_back(std::move(message));
+        m_interactionRate = static_cast<int>(m_interactionUpdates * 1000 / elapsed);
+        m_interactionUpdates = 0;
+        m_interactionWindowStart += elapsed;
     }
 
-    if (result.empty())
+    const auto row = rowOf(messageId);
+    if (row < 0)
+        return;
+
+    // The value is current right away, only the refresh of the delegates is deferred
+    m_messages[row]->interaction_info_ = std::move(interactionInfo);
+
+    if (messageId < m_viewportFirstId || messageId > m_viewportLastId)
     {
-        finalizeLoading();
+        m_interactionStale.insert(messageId);
+        return;
     }
-    else
+
+    m_interactionChanged.insert(messageId);
+
+    if (!m_frameTimer->isActive())
+        m_frameTimer->start();
+}
+
+void MessageModel::handleNavigationIndex(qint64 chatId)
+{
+    if (isSelectedChat(chatId))
+        emit pinnedMessageCountChanged();
+}
+
+void MessageModel::refreshInteractionInfo()
+{
+    auto first = std::numeric_limits<int>::max();
+    auto last = -1;
+
+    for (auto messageId : m_interactionChanged)
     {
-        std::ranges::sort(result, std::ranges::less{}, &Message::id);
-        insertMessages(std::move(result));
+        if (const auto row = rowOf(messageId); row >= 0)
+        {
+            first = std::min(first, row);
+            last = std::max(last, row);
+        }
     }
 
-    emit countChanged();
+    m_interactionChanged.clear();
+
+    // All changed rows are in the viewport, so one signal over their span refreshes little else
+    if (last >= 0)
+        emit dataChanged(index(first), index(last));
+}
+
+void MessageModel::handleDeleteMessages(qint64 chatId, const std::vector<std::int64_t> &messageIds)
+{
+    for (auto messageId : messageIds)
+    {
+        if (auto it = m_replies.find({chatId, messageId}); it != m_replies.end() && it->second)
+        {
+            it->second.reset();
+            replyTargetChanged(chatId, messageId);
+        }
+    }
+
+    if (!isSelectedChat(chatId))
+        return;
+
+    std::vector<std::int64_t> removed;
+    std::ranges::copy_if(messageIds, std::back_inserter(removed), [this](auto messageId) { return rowOf(messageId) >= 0; });
+
+    removeMessages(messageIds);
+
+    // Rows quoting a removed row no longer find it in the model
+    for (auto messageId : removed)
+    {
+        replyTargetChanged(chatId, messageId);
+    }
+}
+
+void MessageModel::handleChatOnlineMemberCount(qint64 chatId, int onlineMemberCount)
+{
+    if (!isSelectedChat(chatId))
+        return;
+
+    m_onlineCount = onlineMemberCount;
+
+    emit selectedChatChanged();
+}
+
+void MessageModel::handleChatAction(qint64 chatId)
+{
+    if (isSelectedChat(chatId))
+        emit chatSubtitleChanged();
+}
+
+void MessageModel::handleDayChanged(qint32 since)
+{
+    // Rows are in date order, so the sections that moved form the tail of the list
+    auto row = static_cast<int>(m_messages.size());
+    while (row > 0 && m_messages[row - 1]->date_ >= since)
+    {
+        --row;
+    }
+
+    if (row < static_cast<int>(m_messages.size()))
+        emit dataChanged(index(row), index(static_cast<int>(m_messages.size()) - 1));
+}
+
+void MessageModel::handleLayouts(const QList<qint64> &messageIds)
+{
+    messagesChanged(messageIds);
 }
 
-void MessageModel::insertMessages(std::vector<std::unique_ptr<Message>> messages) noexcept
+void MessageModel::handleRichText(const QList<qint64> &messageIds)
 {
-    processMessages(messages);
+    messagesChanged(messageIds);
+}
 
-    if (m_loadingHistory)
+void MessageModel::handleChatReadInbox(qint64 chatId)
+{
+    if (isSelectedChat(chatId))
+        emit selectedChatChanged();
+}
+
+void MessageModel::handleChatReadOutbox(qint64 chatId)
+{
+    if (isSelectedChat(chatId))
+        emit selectedChatChanged();
+}
+
+int MessageModel::insertMessages(std::vector<MessagePtr> &&messages)
+{
+    std::ranges::sort(messages, std::ranges::less{}, &td::td_api::message::id_);
+    messages.erase(std::ranges::unique(messages, std::ranges::equal_to{}, &td::td_api::message::id_).begin(), messages.end());
+
+    std::vector<const td::td_api::message *> layouts;
+    layouts.reserve(messages.size());
+
+    // New rows of a restored window already have their layout, refreshed rows may have changed
+    for (const auto &message : messages)
     {
-        m_loadingHistory = false;
-        auto count = static_cast<int>(messages.size());
+        if (!m_layouts->find(message->id_) || rowOf(message->id_) >= 0)
+            layouts.push_back(message.get());
+    }
+
+    layoutMessages(layouts);
+
+    std::vector<const td::td_api::message *> formats;
+    formats.reserve(messages.size());
 
-        beginInsertRows(QModelIndex(), 0, count - 1);
+    for (const auto &message : messages)
+    {
+        formats.push_back(message.get());
+    }
 
-        // Insert messages
-        m_messages.insert(m_messages.begin(), std::make_move_iterator(messages.begin()), std::make_move_iterator(messages.end()));
+    formatMessages(std::move(formats));
 
+    std::vector<const td::td_api::message *> replies;
+
+    for (const auto &message : messages)
+    {
+        if (getReplyTo(*message))
+            replies.push_back(message.get());
+    }
+
+    // Messages that are already loaded are refreshed in place
+    std::erase_if(messages, [this](auto &message) {
+        if (const auto row = rowOf(message->id_); row >= 0)
+        {
+            m_messages[row] = std::move(message);
+            itemChanged(row);
+            return true;
+        }
+        return false;
+    });
+
+    // Replies are resolved once the rows are in, targets among them need no request
+    if (messages.empty())
+    {
+        resolveReplies(replies);
+        return 0;
+    }
+
+    // Messages landing between the same two rows form one block, inserted back to front so that
+    // the positions computed up front stay valid
+    auto end = messages.end();
+    while (end != messages.begin())
+    {
+        const auto position = std::ranges::lower_bound(m_messages, (*std::prev(end))->id_, std::ranges::less{}, &td::td_api::message::id_);
+        const auto row = static_cast<int>(std::distance(m_messages.begin(), position));
+
+        auto begin = std::prev(end);
+        while (begin != messages.begin() && (position == m_messages.begin() || (*std::prev(begin))->id_ > (*std::prev(position))->id_))
+        {
+            --begin;
+        }
+
+        const auto count = static_cast<int>(std::distance(begin, end));
+
+        beginInsertRows(QModelIndex(), row, row + count - 1);
+        m_messages.insert(position, std::make_move_iterator(begin), std::make_move_iterator(end));
         endInsertRows();
-        emit moreHistoriesLoaded(count);
+
+        groupChanged(row - 1);
+        groupChanged(row + count);
+
+        end = begin;
     }
-    else if (m_loading)
+
+    resolveReplies(replies);
+
+    emit countChanged();
+
+    return static_cast<int>(messages.size());
+}
+
+void MessageModel::removeMessages(std::vector<std::int64_t> messageIds)
+{
+    std::vector<int> rows;
+
+    for (auto messageId : messageIds)
     {
-        handleNewMessages(std::move(messages));
+        if (const auto row = rowOf(messageId); row >= 0)
+            rows.push_back(row);
     }
 
-    emit loadingChanged();
+    if (rows.empty())
+        return;
+
+    std::ranges::sort(rows);
+    rows.erase(std::ranges::unique(rows).begin(), rows.end());
+
+    // One removal per contiguous block, from the back so that earlier rows keep their index
+    auto last = static_cast<int>(rows.size()) - 1;
+    while (last >= 0)
+    {
+        auto first = last;
+        while (first > 0 && rows[first - 1] == rows[first] - 1)
+        {
+            --first;
+        }
+
+        beginRemoveRows(QModelIndex(), rows[first], rows[last]);
+        m_messages.erase(m_messages.begin() + rows[first], m_messages.begin() + rows[last] + 1);
+        endRemoveRows();
+
+        groupChanged(rows[first] - 1);
+        groupChanged(rows[first]);
+
+        last = first - 1;
+    }
+
+    emit countChanged();
 }
 
-void MessageModel::finalizeLoading() noexcept
+int MessageModel::rowOf(qint64 messageId) const noexcept
 {
-    if (m_loadingHistory)
-        m_loadingHistory = false;
-    else
-        m_loading = false;
+    const auto it = std::ranges::lower_bound(m_messages, messageId, std::ranges::less{}, &td::td_api::message::id_);
+
+    if (it == m_messages.end() || (*it)->id_ != messageId)
+        return -1;
+
+    return static_cast<int>(std::distance(m_messages.begin(), it));
+}
+
+qint64 MessageModel::oldestMessageId() const noexcept
+{
+    return m_messages.empty() ? 0 : m_messages.front()->id_;
+}
+
+qint64 MessageModel::newestMessageId() const noexcept
+{
+    return m_messages.empty() ? 0 : m_messages.back()->id_;
+}
+
+bool MessageModel::isSelectedChat(qint64 chatId) const noexcept
+{
+    return m_selectedChat && m_selectedChat->id_ == chatId;
+}
+
+void MessageModel::loadMessages() noexcept
+{
+    if (!m_selectedChat)
+        return;
+
+    m_loading = true;
+    m_evictedOlder = false;
+    m_evictedNewer = false;
 
     emit loadingChanged();
+
+    if (auto window = m_storageManager->messagePageCache()->take(m_selectedChat->id_))
+    {
+        restoreWindow(std::move(*window));
+        return;
+    }
+
+    // A prefetched first page fills the model right away, as if the reply had just arrived
+    if (auto page = m_storageManager->historyPrefetcher()->takePage(m_selectedChat->id_))
+    {
+        auto messages = td::td_api::make_object<td::td_api::messages>();
+        messages->total_count_ = static_cast<std::int32_t>(page->messages.size());
+        messages->messages_ = std::move(page->messages);
+
+        handleMessages(messages.release(), page->fromMessageId, NewerLoad);
+        return;
+    }
+
+    const auto slice = HistoryPrefetcher::firstSlice(*m_selectedChat);
+
+    requestHistory(m_selectedChat->id_, slice.fromMessageId, slice.offset, slice.limit, false, NewerLoad);
 }
 
-void MessageModel::processMessages(const std::vector<std::unique_ptr<Message>> &messages) noexcept
+void MessageModel::restoreWindow(MessagePageCache::Window &&window)
 {
-    for (const auto &message : messages)
+    m_ranges = std::move(window.ranges);
+    m_layouts->restore(std::move(window.layouts));
+
+    m_viewportFirstId = window.viewportFirstId;
+    m_viewportLastId = window.viewportLastId;
+    m_pendingJumpId = window.viewportFirstId;
+
+    if (!window.messages.empty())
     {
-        m_messageIds.emplace(message->id());
+        auto messages = td::td_api::make_object<td::td_api::messages>();
+        messages->total_count_ = static_cast<std::int32_t>(window.messages.size());
+        messages->messages_ = std::move(window.messages);
+
+        handleMessages(messages.release(), 0, RestoreLoad);
+        return;
     }
+
+    ++m_historyRequests;
+
+    // Only ids were kept, the database has the messages as they are now
+    auto request = td::td_api::make_object<td::td_api::getMessages>();
+    request->chat_id_ = m_selectedChat->id_;
+    request->message_ids_ = std::move(window.messageIds);
+
+    m_client->send(std::move(request), [this](auto &&response) {
+        QMetaObject::invokeMethod(this, "handleMessages", Qt::QueuedConnection, Q_ARG(td::td_api::Object *, response.release()), Q_ARG(qint64, 0),
+                                  Q_ARG(int, RestoreLoad));
+    });
 }
 
-void MessageModel::handleNewMessages(std::vector<std::unique_ptr<Message>> messages) noexcept
+void MessageModel::requestHistory(qint64 chatId, qint64 fromMessageId, qint32 offset, qint32 limit, bool onlyLocal, HistoryLoad load)
 {
-    if (!m_selectedChat)
+    ++m_historyRequests;
+
+    auto request = td::td_api::make_object<td::td_api::getChatHistory>();
+
+    request->chat_id_ = chatId;
+    request->from_message_id_ = fromMessageId;
+    request->offset_ = offset;
+    request->limit_ = limit;
+    request->only_local_ = onlyLocal;
+
+    // Responses arrive on the client thread, the slot takes ownership of the object
+    m_client->send(std::move(request), [this, chatId, fromMessageId, offset, limit, onlyLocal, load](auto &&response) {
+        // A short local slice means the database does not hold it all, so ask the server instead
+        if (onlyLocal && response->get_id() == td::td_api::messages::ID &&
+            static_cast<const td::td_api::messages &>(*response).messages_.size() < static_cast<std::size_t>(limit))
+        {
+            requestHistory(chatId, fromMessageId, offset, limit, false, load);
+            return;
+        }
+
+        QMetaObject::invokeMethod(this, "handleMessages", Qt::QueuedConnection, Q_ARG(td::td_api::Object *, response.release()), Q_ARG(qint64, fromMessageId),
+                                  Q_ARG(int, load));
+    });
+}
+
+void MessageModel::evictMessages()
+{
+    const auto count = static_cast<int>(m_messages.size());
+    if (count <= m_windowSize)
         return;
 
-    m_loading = false;
+    const auto first = rowOf(m_viewportFirstId);
+    const auto last = rowOf(m_viewportLastId);
+
+    if (first < 0 || last < first)
+        return;
 
-    auto rowCountBefore = rowCount();
-    auto count = static_cast<int>(messages.size());
+    const auto margin = std::max(MessageSliceLimit, (m_windowSize - (last - first + 1)) / 2);
 
-    beginInsertRows(QModelIndex(), rowCountBefore, rowCountBefore + count - 1);
-    m_messages.insert(m_messages.end(), std::make_move_iterator(messages.begin()), std::make_move_iterator(messages.end()));
-    endInsertRows();
+    const auto keepFirst = std::max(0, first - margin);
+    const auto keepLast = std::min(count - 1, last + margin);
 
-    if (m_selectedChat && m_selectedChat->unreadCount() > 0)
+    // Eviction waits for a full slice of excess, so that loading and evicting do not alternate while scrolling.
+    // An end with a request in flight is left alone, its reply would otherwise land beyond the evicted rows.
+    if (count - 1 - keepLast >= MessageSliceLimit && !m_loading)
     {
-        QVariantList messageIds;
-        for (const auto &message : messages)
+        beginRemoveRows(QModelIndex(), keepLast + 1, count - 1);
+        m_messages.erase(m_messages.begin() + keepLast + 1, m_messages.end());
+        endRemoveRows();
+
+        groupChanged(keepLast);
+
+        m_evictedNewer = true;
+
+        emit countChanged();
+    }
+
+    if (keepFirst >= MessageSliceLimit && !m_loadingHistory)
+    {
+        beginRemoveRows(QModelIndex(), 0, keepFirst - 1);
+        m_messages.erase(m_messages.begin(), m_messages.begin() + keepFirst);
+        endRemoveRows();
+
+        groupChanged(0);
+
+        m_evictedOlder = true;
+
+        emit countChanged();
+        emit anchorRequested(first - keepFirst);
+    }
+
+    m_ranges.trim(oldestMessageId(), newestMessageId());
+    m_layouts->retain(oldestMessageId(), newestMessageId());
+
+    // Replies to evicted rows now need their target from elsewhere
+    if (static_cast<int>(m_messages.size()) < count)
+    {
+        std::vector<const td::td_api::message *> replies;
+
+        for (const auto &message : m_messages)
         {
-            auto id = message->id();
-            if (!message->isOutgoing() && id > m_selectedChat->lastReadInboxMessageId())
-            {
-                messageIds.append(id);
-            }
+            if (getReplyTo(*message))
+                replies.push_back(message.get());
         }
 
-        if (!messageIds.isEmpty())
-            viewMessages(messageIds);
+        resolveReplies(replies);
     }
 }
 
-void MessageModel::loadMessages() noexcept
+void MessageModel::viewVisibleMessages()
 {
     if (!m_selectedChat)
         return;
 
-    const auto unread = m_selectedChat->unread_count_ > 0;
+    const auto first = rowOf(m_viewportFirstId);
+    const auto last = rowOf(m_viewportLastId);
 
-    const auto fromMessageId = unread ? m_selectedChat->last_read_inbox_message_id_ : m_selectedChat->last_message_->id_;
+    if (first < 0 || last < first)
+        return;
 
-    const auto offset = unread ? -1 - MessageSliceLimit : 0;
-    const auto limit = unread ? 2 * MessageSliceLimit : MessageSliceLimit;
+    std::vector<std::int64_t> messageIds;
 
-    getChatHistory(fromMessageId, offset, limit);
+    for (auto row = first; row <= last; ++row)
+    {
+        const auto &message = *m_messages[row];
+
+        // Channel posts are reported regardless, it is what counts their views
+        if (message.sending_state_)
+            continue;
+
+        if (message.is_channel_post_ || (!message.is_outgoing_ && message.id_ > m_selectedChat->last_read_inbox_message_id_))
+            messageIds.emplace_back(message.id_);
+    }
+
+    if (!messageIds.empty())
+        m_readReceipts->add(m_selectedChat->id_, messageIds);
 }
 
-void MessageModel::itemChanged(int64_t index)
+void MessageModel::layoutMessages(const std::vector<const td::td_api::message *> &messages)
 {
-    QModelIndex modelIndex = createIndex(static_cast<int>(index), 0);
+    std::vector<MessageLayouts::Request> requests;
+
+    // Strings are resolved here, the locale and the user store are not shared with the worker
+    for (const auto *message : messages)
+    {
+        if (message->content_->get_id() != td::td_api::messageText::ID)
+            continue;
+
+        const auto &text = *static_cast<const td::td_api::messageText &>(*message->content_).text_;
+
+        MessageLayouts::Request request;
+        request.messageId = message->id_;
+        request.text = TextFormatter::toPlain(TextFormatter::toSource(text));
+
+        if (!message->is_outgoing_)
+            request.sender = Utils::getTitle(*message, m_storageManager, m_locale);
+
+        request.date = QDateTime::fromTime_t(message->date_).toString(m_locale->getString("formatterDay12H"));
+
+        requests.emplace_back(std::move(request));
+    }
+
+    m_layouts->layout(std::move(requests));
+}
+
+void MessageModel::formatMessages(std::vector<const td::td_api::message *> messages)
+{
+    auto *cache = m_storageManager->richTextCache();
+
+    std::erase_if(messages, [this, cache](const auto *message) {
+        if (message->content_->get_id() != td::td_api::messageText::ID || m_formatter->isPending(message->id_))
+            return true;
+
+        return static_cast<const td::td_api::messageText &>(*message->content_).text_->entities_.empty() ||
+               cache->contains({message->chat_id_, message->id_, message->edit_date_});
+    });
+
+    // Rows in the viewport first, then outwards; before the viewport is known the chat shows its newest rows
+    const auto distance = [this](const auto *message) -> qint64 {
+        if (m_viewportLastId == 0)
+            return std::numeric_limits<qint64>::max() - message->id_;
+        if (message->id_ < m_viewportFirstId)
+            return m_viewportFirstId - message->id_;
+        if (message->id_ > m_viewportLastId)
+            return message->id_ - m_viewportLastId;
+        return 0;
+    };
+
+    std::ranges::sort(messages, std::ranges::less{}, distance);
+
+    std::vector<TextFormatterPool::Request> requests;
+    requests.reserve(messages.size());
+
+    for (const auto *message : messages)
+    {
+        requests.push_back({{message->chat_id_, message->id_, message->edit_date_},
+                            TextFormatter::toSource(*static_cast<const td::td_api::messageText &>(*message->content_).text_)});
+    }
+
+    m_formatter->format(std::move(requests));
+}
+
+void MessageModel::messagesChanged(const QList<qint64> &messageIds)
+{
+    auto first = std::numeric_limits<int>::max();
+    auto last = -1;
+
+    for (auto messageId : messageIds)
+    {
+        if (const auto row = rowOf(messageId); row >= 0)
+        {
+            first = std::min(first, row);
+            last = std::max(last, row);
+        }
+    }
+
+    // Results arrive per slice, so the rows are mostly adjacent
+    if (last >= 0)
+        emit dataChanged(index(first), index(last));
+}
+
+void MessageModel::fillGaps()
+{
+    if (!m_selectedChat || m_loadingGap)
+        return;
+
+    const auto first = rowOf(m_viewportFirstId);
+    const auto last = rowOf(m_viewportLastId);
+
+    if (first < 0 || last < first)
+        return;
+
+    const auto from = std::max(0, first - MessageSliceLimit);
+    const auto to = std::min(static_cast<int>(m_messages.size()) - 1, last + MessageSliceLimit);
+
+    for (auto row = from; row < to; ++row)
+    {
+        const auto older = m_messages[row]->id_;
+        const auto newer = m_messages[row + 1]->id_;
+
+        if (m_ranges.isContiguous(older, newer))
+            continue;
+
+        m_loadingGap = true;
+
+        // Fill from the side the viewport is on, so that the visible rows stay put
+        if (row < first)
+            requestHistory(m_selectedChat->id_, newer, 0, MessageSliceLimit, false, GapLoad);
+        else
+            requestHistory(m_selectedChat->id_, older, 1 - MessageSliceLimit, MessageSliceLimit, false, GapLoad);
+
+        return;
+    }
+}
+
+void MessageModel::itemChanged(int row)
+{
+    QModelIndex modelIndex = createIndex(row, 0);
 
     emit dataChanged(modelIndex, modelIndex);
 }
+
+std::pair<int, int> MessageModel::albumBounds(int row) const noexcept
+{
+    const auto albumId = m_messages[row]->media_album_id_;
+    if (albumId == 0)
+        return {row, row};
+
+    // Albums hold at most ten messages, so the scan is bounded
+    auto first = row;
+    while (first > 0 && m_messages[first - 1]->media_album_id_ == albumId)
+    {
+        --first;
+    }
+
+    auto last = row;
+    while (last + 1 < static_cast<int>(m_messages.size()) && m_messages[last + 1]->media_album_id_ == albumId)
+    {
+        ++last;
+    }
+
+    return {first, last};
+}
+
+bool MessageModel::isSameRun(int row, int nextRow) const
+{
+    const auto &message = *m_messages[row];
+    const auto &next = *m_messages[nextRow];
+
+    if (Utils::isServiceMessage(message) || Utils::isServiceMessage(next))
+        return false;
+
+    // A run does not continue into the next day's section
+    if (QDateTime::fromTime_t(message.date_).date() != QDateTime::fromTime_t(next.date_).date())
+        return false;
+
+    return isSameSender(*message.sender_id_, *next.sender_id_);
+}
+
+void MessageModel::groupChanged(int row)
+{
+    if (row < 0 || row >= static_cast<int>(m_messages.size()))
+        return;
+
+    const auto [first, last] = albumBounds(row);
+
+    emit dataChanged(index(first), index(last));
+}
+
+void MessageModel::handleReplies(td::td_api::Object *object, qint64 chatId, const QVariantList &messageIds)
+{
+    td::td_api::object_ptr<td::td_api::Object> response(object);
+
+    // Targets that do not come back are remembered as gone, so that they are not asked for again
+    for (const auto &value : messageIds)
+    {
+        const ReplyKey key{chatId, value.toLongLong()};
+
+        m_pendingReplies.erase(key);
+        m_replies[key] = nullptr;
+    }
+
+    if (response->get_id() == td::td_api::messages::ID)
+    {
+        for (auto &message : td::move_tl_object_as<td::td_api::messages>(response)->messages_)
+        {
+            if (message)
+                m_replies[{message->chat_id_, message->id_}] = std::move(message);
+        }
+    }
+
+    for (const auto &value : messageIds)
+    {
+        replyTargetChanged(chatId, value.toLongLong());
+    }
+}
+
+void MessageModel::handleSearchResults(td::td_api::Object *object, const QString &query)
+{
+    td::td_api::object_ptr<td::td_api::Object> response(object);
+
+    // Typing went on, or the chat was closed, while TDLib was searching
+    if (query != m_searchQuery || response->get_id() != td::td_api::foundChatMessages::ID)
+        return;
+
+    const auto result = td::move_tl_object_as<td::td_api::foundChatMessages>(response);
+
+    std::set<qint64, std::greater<>> ids;
+
+    for (const auto &value : m_searchResults)
+    {
+        ids.insert(value.toLongLong());
+    }
+
+    for (const auto &message : result->messages_)
+    {
+        if (message && isSelectedChat(message->chat_id_))
+            ids.insert(message->id_);
+    }
+
+    if (static_cast<int>(ids.size()) == m_searchResults.size())
+        return;
+
+    m_searchResults.clear();
+
+    for (auto it = ids.begin(); it != ids.end() && m_searchResults.size() < MessageSearchLimit; ++it)
+    {
+        m_searchResults.append(*it);
+    }
+
+    emit searchResultsChanged();
+}
+
+void MessageModel::searchRemote()
+{
+    if (!m_selectedChat || m_searchQuery.isEmpty())
+        return;
+
+    // Only the part of the history the index has not seen; 0 searches the whole chat
+    auto request = td::td_api::make_object<td::td_api::searchChatMessages>();
+    request->chat_id_ = m_selectedChat->id_;
+    request->query_ = m_searchQuery.toStdString();
+    request->from_message_id_ = m_searchIndex->unindexedFrom(m_selectedChat->id_);
+    request->offset_ = 0;
+    request->limit_ = MessageSearchLimit;
+
+    m_client->send(std::move(request), [this, query = m_searchQuery](auto &&response) {
+        QMetaObject::invokeMethod(this, "handleSearchResults", Qt::QueuedConnection, Q_ARG(td::td_api::Object *, response.release()), Q_ARG(QString, query));
+    });
+}
+
+void MessageModel::clearSearch()
+{
+    m_searchTimer->stop();
+    m_searchQuery.clear();
+
+    if (m_searchResults.isEmpty())
+        return;
+
+    m_searchResults.clear();
+
+    emit searchResultsChanged();
+}
+
+void MessageModel::resolveReplies(const std::vector<const td::td_api::message *> &messages)
+{
+    std::map<qint64, std::vector<std::int64_t>> missing;
+
+    for (const auto *message : messages)
+    {
+        const auto *replyTo = getReplyTo(*message);
+        if (!replyTo)
+            continue;
+
+        const ReplyKey key{replyTo->chat_id_, replyTo->message_id_};
+
+        if (isSelectedChat(key.first) && rowOf(key.second) >= 0)
+            continue;
+
+        if (m_replies.contains(key) || !m_pendingReplies.insert(key).second)
+            continue;
+
+        missing[key.first].push_back(key.second);
+    }
+
+    for (auto &[chatId, messageIds] : missing)
+    {
+        QVariantList ids;
+
+        for (auto id : messageIds)
+        {
+            ids.append(static_cast<qint64>(id));
+        }
+
+        auto request = td::td_api::make_object<td::td_api::getMessages>();
+        request->chat_id_ = chatId;
+        request->message_ids_ = std::move(messageIds);
+
+        m_client->send(std::move(request), [this, chatId, ids](auto &&response) {
+            QMetaObject::invokeMethod(this, "handleReplies", Qt::QueuedConnection, Q_ARG(td::td_api::Object *, response.release()), Q_ARG(qint64, chatId),
+                                      Q_ARG(QVariantList, ids));
+        });
+    }
+}
+
+const td::td_api::message *MessageModel::replyTarget(const td::td_api::message &message) const
+{
+    const auto *replyTo = getReplyTo(message);
+    if (!replyTo)
+        return nullptr;
+
+    if (isSelectedChat(replyTo->chat_id_))
+    {
+        if (const auto row = rowOf(replyTo->message_id_); row >= 0)
+            return m_messages[row].get();
+    }
+
+    if (auto it = m_replies.find({replyTo->chat_id_, replyTo->message_id_}); it != m_replies.end())
+        return it->second.get();
+
+    return nullptr;
+}
+
+void MessageModel::replyTargetChanged(qint64 chatId, qint64 messageId)
+{
+    // The window is bounded, a scan is cheaper than keeping a reverse index in step with it
+    for (auto row = 0; row < static_cast<int>(m_messages.size()); ++row)
+    {
+        if (const auto *replyTo = getReplyTo(*m_messages[row]); replyTo && replyTo->chat_id_ == chatId && replyTo->message_id_ == messageId)
+            itemChanged(row);
+    }
+}
@@ -1,17 +1,33 @@
 #pragma once
 
+#include "Common.hpp"
+#include "MessagePageCache.hpp"
+#include "MessageRanges.hpp"
+
 #include <td/telegram/td_api.h>
 
 #include <QAbstractListModel>
-
-#include <memory>
-#include <optional>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 class Client;
 class Locale;
+class MessageLayouts;
+class MessageSearchIndex;
+class NavigationIndex;
+class QTimer;
+class ReadReceipts;
 class StorageManager;
+class TextFormatterPool;
 
 class MessageModel : public QAbstractListModel
 {
@@ -19,7 +35,7 @@ class MessageModel : public QAbstractListModel
 
     Q_PROPERTY(QString chatId READ getChatId NOTIFY selectedChatChanged)
 
-    Q_PROPERTY(QString chatSubtitle READ getChatSubtitle NOTIFY selectedChatChanged)
+    Q_PROPERTY(QString chatSubtitle READ getChatSubtitle NOTIFY chatSubtitleChanged)
     Q_PROPERTY(QString chatTitle READ getChatTitle NOTIFY selectedChatChanged)
     Q_PROPERTY(QString chatPhoto READ getChatPhoto NOTIFY selectedChatChanged)
 
@@ -27,6 +43,11 @@ class MessageModel : public QAbstractListModel
     Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
     Q_PROPERTY(bool loadingHistory READ loadingHistory NOTIFY loadingChanged)
 
+    Q_PROPERTY(int windowSize READ windowSize WRITE setWindowSize NOTIFY windowSizeChanged)
+
+    Q_PROPERTY(QVariantList searchResults READ searchResults NOTIFY searchResultsChanged)
+    Q_PROPERTY(int pinnedMessageCount READ pinnedMessageCount NOTIFY pinnedMessageCountChanged)
+
 public:
     explicit MessageModel(QObject *parent = nullptr);
 
@@ -35,33 +56,43 @@ public:
         SenderRole,
         ChatIdRole,
         SendingStateRole,
-        SchedulingStateRole,
         IsOutgoingRole,
         IsPinnedRole,
         CanBeEditedRole,
         CanBeForwardedRole,
         CanBeDeletedOnlyForSelfRole,
         CanBeDeletedForAllUsersRole,
-        CanGetStatisticsRole,
-        CanGetMessageThreadRole,
         IsChannelPostRole,
         ContainsUnreadMentionRole,
         DateRole,
         EditDateRole,
-        ForwardInfoRole,
-        InteractionInfoRole,
+        ViewCountRole,
         MessageThreadIdRole,
         ViaBotUserIdRole,
         AuthorSignatureRole,
         MediaAlbumIdRole,
-        RestrictionReasonRole,
-        ContentRole,
-        ReplyMarkupRole,
+        ContentTypeRole,
+        TextRole,
         // Custom role
         BubbleColorRole,
         IsServiceMessageRole,
         SectionRole,
         ServiceMessageRole,
+        // Precomputed layout, 0 until the worker has measured the message
+        PortraitTextWidthRole,
+        PortraitTextHeightRole,
+        LandscapeTextWidthRole,
+        LandscapeTextHeightRole,
+        SenderWidthRole,
+        DateWidthRole,
+        // Grouping of neighbouring rows, derived from the adjacent rows only
+        FirstInGroupRole,
+        GroupSizeRole,
+        ShowSenderRole,
+        ShowAvatarRole,
+        ReplyToRole,
+        // Formatted once per message version and cached
+        RichTextRole,
     };
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -78,6 +109,12 @@ public:
     bool loading() const noexcept;
     bool loadingHistory() const noexcept;
 
+    int windowSize() const noexcept;
+    void setWindowSize(int value);
+
+    QVariantList searchResults() const noexcept;
+    int pinnedMessageCount() const noexcept;
+
     QString getChatId() const noexcept;
     void setChatId(const QString &value) noexcept;
 
@@ -86,6 +123,17 @@ public:
     QString getChatPhoto() const noexcept;
 
     Q_INVOKABLE void loadHistory() noexcept;
+    Q_INVOKABLE void setViewport(int firstRow, int lastRow);
+    Q_INVOKABLE void jumpToMessage(qint64 messageId);
+
+    // Answers from the local index at once, TDLib fills in what the index does not cover
+    Q_INVOKABLE void searchMessages(const QString &query);
+
+    // Jumps load only the slice around the target; false while the chat has nothing to jump to
+    Q_INVOKABLE bool jumpToNextMention();
+    Q_INVOKABLE bool jumpToNextPinned();
+
+    Q_INVOKABLE QVariantMap metrics() const;
 
     Q_INVOKABLE void openChat() noexcept;
     Q_INVOKABLE void closeChat() noexcept;
@@ -100,49 +148,197 @@ signals:
     void moreHistoriesLoaded(int modelIndex);
     void loadingChanged();
     void selectedChatChanged();
+    void windowSizeChanged();
+    void anchorRequested(int modelIndex);
+    void chatSubtitleChanged();
+    void searchResultsChanged();
+    void pinnedMessageCountChanged();
 
 public slots:
     void refresh() noexcept;
 
 private slots:
     void handleResult(td::td_api::Object *object);
+    void handleMessages(td::td_api::Object *object, qint64 fromMessageId, int load);
+    void handleChatAction(qint64 chatId);
+    void handleDayChanged(qint32 since);
+    void handleLayouts(const QList<qint64> &messageIds);
+    void handleRichText(const QList<qint64> &messageIds);
+    void handleReplies(td::td_api::Object *object, qint64 chatId, const QVariantList &messageIds);
+    void handleSearchResults(td::td_api::Object *object, const QString &query);
+    void handleMessageSent(td::td_api::Object *object, qint64 tappedAt);
+
+    void searchRemote();
+
+    void refreshInteractionInfo();
+
+    void handleNavigationIndex(qint64 chatId);
 
 private:
-    void handleNewMessage(const td::td_api::message &message);
-    void handleMessageSendSucceeded(const td::td_api::message &message, qint64 oldMessageId);
-    void handleMessageSendFailed(const td::td_api::message &message, qint64 oldMessageId, int errorCode, const std::string &errorMessage);
-    void handleMessageContent(qint64 chatId, qint64 messageId, const QVariantMap &newContent);
-    void handleMessageEdited(qint64 chatId, qint64 messageId, int editDate, const QVariantMap &replyMarkup);
+    static constexpr auto SearchInterval = 300;  // msec
+    static constexpr auto FrameInterval = 16;  // msec
+
+    using MessagePtr = td::td_api::object_ptr<td::td_api::message>;
+
+    enum HistoryLoad {
+        NewerLoad,
+        OlderLoad,
+        GapLoad,
+        RestoreLoad,
+    };
+
+    void handleNewMessage(MessagePtr &&message);
+    void handleMessageSendSucceeded(MessagePtr &&message, qint64 oldMessageId);
+    void handleMessageSendFailed(MessagePtr &&message, qint64 oldMessageId);
+
+    // Puts the message in the row of its temporary version, in place when its id sorts to the same row
+    void replaceSentMessage(MessagePtr &&message, qint64 oldMessageId);
+    void handleMessageContent(qint64 chatId, qint64 messageId, td::td_api::object_ptr<td::td_api::MessageContent> &&newContent);
+    void handleMessageEdited(qint64 chatId, qint64 messageId, int editDate, td::td_api::object_ptr<td::td_api::ReplyMarkup> &&replyMarkup);
     void handleMessageIsPinned(qint64 chatId, qint64 messageId, bool isPinned);
-    void handleMessageInteractionInfo(qint64 chatId, qint64 messageId, const QVariantMap &interactionInfo);
-    void handleDeleteMessages(qint64 chatId, const QVariantList &messageIds, bool isPermanent, bool fromCache);
+    void handleMessageInteractionInfo(qint64 chatId, qint64 messageId, td::td_api::object_ptr<td::td_api::messageInteractionInfo> &&interactionInfo);
+    void handleDeleteMessages(qint64 chatId, const std::vector<std::int64_t> &messageIds);
 
     void handleChatOnlineMemberCount(qint64 chatId, int onlineMemberCount);
 
-    void handleChatReadInbox(qint64 chatId, qint64 lastReadInboxMessageId, int unreadCount);
-    void handleChatReadOutbox(qint64 chatId, qint64 lastReadOutboxMessageId);
-    void handleMessages(td::td_api::object_ptr<td::td_api::messages> &&messages);
-    void insertMessages(std::vector<std::unique_ptr<Message>> &&messages) noexcept;
+    void handleChatReadInbox(qint64 chatId);
+    void handleChatReadOutbox(qint64 chatId);
+
+    // m_messages is kept sorted by message id, so row lookups are binary searches
+    int insertMessages(std::vector<MessagePtr> &&messages);
+    void removeMessages(std::vector<std::int64_t> messageIds);
 
-    void finalizeLoading() noexcept;
-    void processMessages(const std::vector<std::unique_ptr<Message>> &messages) noexcept;
-    void handleNewMessages(std::vector<std::unique_ptr<Message>> messages) noexcept;
+    [[nodiscard]] int rowOf(qint64 messageId) const noexcept;
+    [[nodiscard]] qint64 oldestMessageId() const noexcept;
+    [[nodiscard]] qint64 newestMessageId() const noexcept;
+
+    [[nodiscard]] bool isSelectedChat(qint64 chatId) const noexcept;
 
     void loadMessages() noexcept;
 
-    void itemChanged(int64_t index);
+    // Brings back a cached window, then loads what arrived while the chat was closed
+    void restoreWindow(MessagePageCache::Window &&window);
+    void requestHistory(qint64 chatId, qint64 fromMessageId, qint32 offset, qint32 limit, bool onlyLocal, HistoryLoad load);
+
+    // Requests the slice between two loaded rows of different ranges next to the viewport
+    void fillGaps();
+
+    // Drops rows that are more than half a window away from the viewport
+    void evictMessages();
+
+    // Hands the unread rows between the viewport bounds to the read receipts
+    void viewVisibleMessages();
+
+    // Queues text messages for layout on the worker thread
+    void layoutMessages(const std::vector<const td::td_api::message *> &messages);
+
+    // Queues text messages with entities for formatting, the ones nearest to the viewport first
+    void formatMessages(std::vector<const td::td_api::message *> messages);
+
+    void messagesChanged(const QList<qint64> &messageIds);
+
+    void itemChanged(int row);
+
+    // Rows of the album holding row, or just row outside of an album
+    [[nodiscard]] std::pair<int, int> albumBounds(int row) const noexcept;
+
+    // Whether two adjacent rows belong to one run of the same sender
+    [[nodiscard]] bool isSameRun(int row, int nextRow) const;
+
+    // Refreshes the rows whose grouping depends on the neighbours of row, after rows appeared or vanished next to it
+    void groupChanged(int row);
+
+    using ReplyKey = std::pair<qint64, qint64>;  // chat id, message id
+
+    // Requests the reply targets that are neither loaded nor cached, with one getMessages per chat
+    void resolveReplies(const std::vector<const td::td_api::message *> &messages);
+
+    [[nodiscard]] const td::td_api::message *replyTarget(const td::td_api::message &message) const;
+
+    // Refreshes the rows that reply to the given message
+    void replyTargetChanged(qint64 chatId, qint64 messageId);
+
+    void clearSearch();
+
+    struct OutgoingMessage
+    {
+        qint64 chatId{};
+        QString text;
+        qint64 replyToMessageId{};
+        qint64 tappedAt{};
+    };
+
+    // Hands the next queued message to TDLib once the previous one has its temporary id
+    void sendNext();
 
     Client *m_client{};
     Locale *m_locale{};
     StorageManager *m_storageManager{};
 
+    ReadReceipts *m_readReceipts;
+    MessageLayouts *m_layouts;
+    TextFormatterPool *m_formatter;
+    MessageSearchIndex *m_searchIndex{};
+    NavigationIndex *m_navigationIndex{};
+
+    QTimer *m_searchTimer;
+    QTimer *m_frameTimer;
+
     int m_onlineCount = 0;
 
-    bool m_loading = true;
-    bool m_loadingHistory = true;
+    bool m_loading = false;
+    bool m_loadingHistory = false;
+    bool m_loadingGap = false;
+
+    int m_windowSize = MessageWindowSize;
+
+    qint64 m_viewportFirstId{};
+    qint64 m_viewportLastId{};
+
+    // Evicted slices are still in the local database and are fetched back from there first
+    bool m_evictedOlder = false;
+    bool m_evictedNewer = false;
+
+    qint64 m_pendingJumpId{};
+
+    // Where the last jump went, so that repeated jumps move on before the target is marked read
+    qint64 m_mentionJumpId{};
+    qint64 m_pinnedJumpId{};
+
+    MessageRanges m_ranges;
+
+    std::atomic<int> m_historyRequests{0};
 
     const td::td_api::chat *m_selectedChat{};
 
-    std::unordered_set<std::optional<qint64>> m_messageIds;
-    std::vector<td::td_api::object_ptr<td::td_api::message>> m_messages;
+    std::vector<MessagePtr> m_messages;
+
+    // Reply targets outside of the loaded rows; null for targets that are gone
+    std::map<ReplyKey, MessagePtr> m_replies;
+    std::set<ReplyKey> m_pendingReplies;
+
+    QString m_searchQuery;
+    QVariantList m_searchResults;
+
+    QElapsedTimer m_clock;
+
+    // Interaction info is stored as it arrives; rows in the viewport are refreshed once per frame,
+    // the others when they scroll into it
+    std::unordered_set<qint64> m_interactionChanged;
+    std::unordered_set<qint64> m_interactionStale;
+
+    int m_interactionUpdates{};
+    int m_interactionRate{};
+    qint64 m_interactionWindowStart{};
+
+    std::deque<OutgoingMessage> m_sendQueue;
+    bool m_sending = false;
+
+    // Temporary message id to the time the message was sent
+    std::unordered_map<qint64, qint64> m_pendingSends;
+
+    int m_sentCount{};
+    int m_failedSendCount{};
+    qint64 m_lastSendLatency{};
+    qint64 m_totalSendLatency{};
 };
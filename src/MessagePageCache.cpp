@@ -0,0 +1,325 @@
+#include "MessagePageCache.hpp"
+
+#include "Common.hpp"
+#include "StorageManager.hpp"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+
+#include <algorithm>
+
+MessagePageCache::MessagePageCache(StorageManager *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_saveTimer(new QTimer(this))
+{
+    connect(m_store->client(), SIGNAL(result(td::td_api::Object *)), this, SLOT(handleResult(td::td_api::Object *)));
+    connect(m_store->settings(), SIGNAL(messageCacheOnDiskChanged()), this, SLOT(handleCacheOnDiskChanged()));
+    connect(m_saveTimer, SIGNAL(timeout()), this, SLOT(save()));
+
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(SaveDelay);
+
+    if (m_store->settings()->messageCacheOnDisk())
+        load();
+}
+
+MessagePageCache::~MessagePageCache()
+{
+    // A save still waiting for its delay is done on quit
+    if (m_saveTimer->isActive())
+        save();
+}
+
+void MessagePageCache::put(qint64 chatId, Window &&window)
+{
+    std::erase_if(m_windows, [chatId](const auto &value) { return value.first == chatId; });
+
+    m_windows.emplace_back(chatId, std::move(window));
+
+    const auto onDisk = m_store->settings()->messageCacheOnDisk();
+    const auto capacity = static_cast<std::size_t>(onDisk ? DiskCapacity : MemoryCapacity);
+
+    if (m_windows.size() > capacity)
+        m_windows.erase(m_windows.begin(), m_windows.end() - capacity);
+
+    if (m_windows.size() > MemoryCapacity)
+    {
+        for (auto it = m_windows.begin(); it != m_windows.end() - MemoryCapacity; ++it)
+            demote(it->second);
+    }
+
+    scheduleSave();
+}
+
+std::optional<MessagePageCache::Window> MessagePageCache::take(qint64 chatId)
+{
+    auto it = std::ranges::find(m_windows, chatId, &std::pair<qint64, Window>::first);
+    if (it == m_windows.end())
+        return std::nullopt;
+
+    // The chat goes back to a model, which puts it back when the chat is closed; the file keeps it meanwhile
+    auto window = std::move(it->second);
+    m_windows.erase(it);
+
+    if (window.messages.empty() && window.messageIds.empty())
+        return std::nullopt;
+
+    return window;
+}
+
+void MessagePageCache::handleResult(td::td_api::Object *object)
+{
+    // Only chats that are closed are here, the open one is kept up to date by its model, so fields are taken from updates
+    // only for windows of closed chats
+    switch (object->get_id())
+    {
+        case td::td_api::updateDeleteMessages::ID: {
+            const auto &update = static_cast<const td::td_api::updateDeleteMessages &>(*object);
+
+            if (auto *window = find(update.chat_id_); window && !update.from_cache_)
+            {
+                const auto deleted = [&update](std::int64_t id) { return std::ranges::find(update.message_ids_, id) != update.message_ids_.end(); };
+
+                std::erase_if(window->messages, [&deleted](const auto &message) { return deleted(message->id_); });
+                std::erase_if(window->messageIds, deleted);
+
+                scheduleSave();
+            }
+            break;
+        }
+        case td::td_api::updateMessageSendSucceeded::ID:
+        case td::td_api::updateMessageSendFailed::ID: {
+            const auto &message = object->get_id() == td::td_api::updateMessageSendSucceeded::ID
+                                      ? *static_cast<const td::td_api::updateMessageSendSucceeded &>(*object).message_
+                                      : *static_cast<const td::td_api::updateMessageSendFailed &>(*object).message_;
+            const auto oldMessageId = object->get_id() == td::td_api::updateMessageSendSucceeded::ID
+                                          ? static_cast<const td::td_api::updateMessageSendSucceeded &>(*object).old_message_id_
+                                          : static_cast<const td::td_api::updateMessageSendFailed &>(*object).old_message_id_;
+
+            if (auto *window = find(message.chat_id_))
+            {
+                // The message itself goes on to the models, the window keeps its new id and reads it back on reopen
+                const auto contains = std::ranges::find(window->messages, oldMessageId, &td::td_api::message::id_) != window->messages.end() ||
+                                      std::ranges::find(window->messageIds, oldMessageId) != window->messageIds.end();
+                if (!contains)
+                    break;
+
+                demote(*window);
+
+                std::erase(window->messageIds, oldMessageId);
+                window->messageIds.insert(std::ranges::upper_bound(window->messageIds, message.id_), message.id_);
+
+                scheduleSave();
+            }
+            break;
+        }
+        case td::td_api::updateMessageIsPinned::ID: {
+            const auto &update = static_cast<const td::td_api::updateMessageIsPinned &>(*object);
+
+            if (auto *window = find(update.chat_id_))
+            {
+                if (auto it = std::ranges::find(window->messages, update.message_id_, &td::td_api::message::id_); it != window->messages.end())
+                    (*it)->is_pinned_ = update.is_pinned_;
+            }
+            break;
+        }
+        case td::td_api::updateMessageContent::ID:
+            if (auto *window = find(static_cast<const td::td_api::updateMessageContent &>(*object).chat_id_))
+                demote(*window);
+            break;
+        case td::td_api::updateMessageEdited::ID: {
+            auto &update = static_cast<td::td_api::updateMessageEdited &>(*object);
+
+            // The new content, if any, comes with updateMessageContent
+            if (auto *window = find(update.chat_id_))
+            {
+                if (auto it = std::ranges::find(window->messages, update.message_id_, &td::td_api::message::id_); it != window->messages.end())
+                {
+                    (*it)->edit_date_ = update.edit_date_;
+                    (*it)->reply_markup_ = std::move(update.reply_markup_);
+                }
+            }
+            break;
+        }
+        case td::td_api::updateMessageInteractionInfo::ID: {
+            auto &update = static_cast<td::td_api::updateMessageInteractionInfo &>(*object);
+
+            // View counts of busy channels change every few seconds, they must not cost the window its messages
+            if (auto *window = find(update.chat_id_))
+            {
+                if (auto it = std::ranges::find(window->messages, update.message_id_, &td::td_api::message::id_); it != window->messages.end())
+                    (*it)->interaction_info_ = std::move(update.interaction_info_);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void MessagePageCache::handleCacheOnDiskChanged()
+{
+    if (m_store->settings()->messageCacheOnDisk())
+    {
+        save();
+        return;
+    }
+
+    m_saveTimer->stop();
+    QFile::remove(fileName());
+
+    if (m_windows.size() > MemoryCapacity)
+        m_windows.erase(m_windows.begin(), m_windows.end() - MemoryCapacity);
+}
+
+void MessagePageCache::scheduleSave()
+{
+    if (m_store->settings()->messageCacheOnDisk())
+        m_saveTimer->start();
+}
+
+MessagePageCache::Window *MessagePageCache::find(qint64 chatId)
+{
+    auto it = std::ranges::find(m_windows, chatId, &std::pair<qint64, Window>::first);
+    return it != m_windows.end() ? &it->second : nullptr;
+}
+
+void MessagePageCache::demote(Window &window)
+{
+    if (window.messages.empty())
+        return;
+
+    window.messageIds.clear();
+    window.messageIds.reserve(window.messages.size());
+
+    for (const auto &message : window.messages)
+    {
+        window.messageIds.push_back(message->id_);
+    }
+
+    window.messages.clear();
+    window.layouts.clear();
+}
+
+void MessagePageCache::load()
+{
+    // The previous save got as far as removing the old file, the new one is complete
+    if (!QFile::exists(fileName()))
+        QFile::rename(fileName() + ".tmp", fileName());
+
+    QFile file(fileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+
+    stream >> magic >> version >> count;
+
+    if (magic != FileMagic || version != FileVersion)
+        return;
+
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+        qint64 chatId = 0;
+        quint32 idCount = 0;
+        quint32 rangeCount = 0;
+
+        Window window;
+
+        stream >> chatId >> window.viewportFirstId >> window.viewportLastId >> idCount;
+
+        // A window never holds more than a few model windows, anything larger is a damaged file
+        if (idCount > 4 * MessageWindowSize)
+            break;
+
+        window.messageIds.reserve(idCount);
+
+        for (quint32 j = 0; j < idCount; ++j)
+        {
+            qint64 id = 0;
+            stream >> id;
+            window.messageIds.push_back(id);
+        }
+
+        stream >> rangeCount;
+
+        for (quint32 j = 0; j < rangeCount && stream.status() == QDataStream::Ok; ++j)
+        {
+            qint64 first = 0;
+            qint64 last = 0;
+
+            stream >> first >> last;
+            window.ranges.insert(first, last);
+        }
+
+        if (stream.status() == QDataStream::Ok)
+            m_windows.emplace_back(chatId, std::move(window));
+    }
+}
+
+void MessagePageCache::save() const
+{
+    QDir().mkpath(QFileInfo(fileName()).absolutePath());
+
+    // Written next to the old file and swapped in, so that a crash while writing does not lose every window
+    const auto temporaryName = fileName() + ".tmp";
+
+    QFile file(temporaryName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_7);
+
+    stream << FileMagic << FileVersion << static_cast<quint32>(m_windows.size());
+
+    for (const auto &[chatId, window] : m_windows)
+    {
+        stream << chatId << window.viewportFirstId << window.viewportLastId;
+
+        if (window.messages.empty())
+        {
+            stream << static_cast<quint32>(window.messageIds.size());
+
+            for (auto id : window.messageIds)
+                stream << static_cast<qint64>(id);
+        }
+        else
+        {
+            stream << static_cast<quint32>(window.messages.size());
+
+            for (const auto &message : window.messages)
+                stream << static_cast<qint64>(message->id_);
+        }
+
+        stream << static_cast<quint32>(window.ranges.values().size());
+
+        for (const auto &[first, last] : window.ranges.values())
+            stream << first << last;
+    }
+
+    if (stream.status() != QDataStream::Ok || !file.flush() || file.error() != QFile::NoError)
+    {
+        file.remove();
+        return;
+    }
+
+    file.close();
+
+    QFile::remove(fileName());
+    QFile::rename(temporaryName, fileName());
+}
+
+QString MessagePageCache::fileName()
+{
+    return QDir::homePath() + "/.meegram/messagepages.dat";
+}
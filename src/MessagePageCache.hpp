@@ -0,0 +1,81 @@
+#pragma once
+
+#include "MessageLayouts.hpp"
+#include "MessageRanges.hpp"
+
+#include <td/telegram/td_api.h>
+
+#include <QObject>
+#include <QString>
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class QTimer;
+class StorageManager;
+
+// Message windows of recently closed chats, most recent last. The newest few keep their
+// messages and layouts in memory; older ones, and ones whose messages changed while the
+// chat was closed, keep only ids and are read back from the TDLib database on reopen.
+// With messageCacheOnDisk the id form is written out, so that it survives a restart.
+class MessagePageCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Window
+    {
+        std::vector<td::td_api::object_ptr<td::td_api::message>> messages;
+        // In place of messages once the window has been demoted or read from disk
+        std::vector<std::int64_t> messageIds;
+
+        MessageRanges ranges;
+        std::unordered_map<qint64, MessageLayouts::Layout> layouts;
+
+        qint64 viewportFirstId{};
+        qint64 viewportLastId{};
+    };
+
+    explicit MessagePageCache(StorageManager *store, QObject *parent = nullptr);
+    ~MessagePageCache() override;
+
+    void put(qint64 chatId, Window &&window);
+    [[nodiscard]] std::optional<Window> take(qint64 chatId);
+
+private slots:
+    void handleResult(td::td_api::Object *object);
+    void handleCacheOnDiskChanged();
+
+    void save() const;
+
+private:
+    static constexpr auto MemoryCapacity = 8;
+    static constexpr auto DiskCapacity = 32;
+
+    // Chats closed in quick succession are written out once
+    static constexpr auto SaveDelay = 2000;  // msec
+
+    static constexpr quint32 FileMagic = 0x4d475043;  // "MGPC"
+    static constexpr quint32 FileVersion = 1;
+
+    [[nodiscard]] Window *find(qint64 chatId);
+
+    // Windows are written out a little later, so that a burst of changes is saved once
+    void scheduleSave();
+
+    // Keeps the ids, anchors and ranges of a window and lets go of everything else
+    static void demote(Window &window);
+
+    void load();
+
+    [[nodiscard]] static QString fileName();
+
+    StorageManager *m_store{};
+
+    QTimer *m_saveTimer;
+
+    std::vector<std::pair<qint64, Window>> m_windows;
+};
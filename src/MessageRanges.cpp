@@ -0,0 +1,56 @@
+#include "MessageRanges.hpp"
+
+#include <algorithm>
+
+void MessageRanges::insert(qint64 first, qint64 last)
+{
+    if (first > last)
+        std::swap(first, last);
+
+    // Every range overlapping the new one is folded into it
+    auto begin = std::ranges::lower_bound(m_ranges, first, std::ranges::less{}, &std::pair<qint64, qint64>::second);
+    auto end = begin;
+
+    while (end != m_ranges.end() && end->first <= last)
+    {
+        first = std::min(first, end->first);
+        last = std::max(last, end->second);
+        ++end;
+    }
+
+    auto it = m_ranges.erase(begin, end);
+    m_ranges.emplace(it, first, last);
+}
+
+void MessageRanges::trim(qint64 first, qint64 last)
+{
+    std::erase_if(m_ranges, [first, last](const auto &range) { return range.second < first || range.first > last; });
+
+    if (!m_ranges.empty())
+    {
+        m_ranges.front().first = std::max(m_ranges.front().first, first);
+        m_ranges.back().second = std::min(m_ranges.back().second, last);
+    }
+}
+
+void MessageRanges::clear() noexcept
+{
+    m_ranges.clear();
+}
+
+bool MessageRanges::isContiguous(qint64 first, qint64 last) const noexcept
+{
+    auto it = std::ranges::lower_bound(m_ranges, first, std::ranges::less{}, &std::pair<qint64, qint64>::second);
+
+    return it != m_ranges.end() && it->first <= first && last <= it->second;
+}
+
+int MessageRanges::size() const noexcept
+{
+    return static_cast<int>(m_ranges.size());
+}
+
+const std::vector<std::pair<qint64, qint64>> &MessageRanges::values() const noexcept
+{
+    return m_ranges;
+}
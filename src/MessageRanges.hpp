@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <utility>
+#include <vector>
+
+// Spans of message ids known to be contiguous in a chat history. Two loaded messages
+// with no range holding both have a gap between them that still has to be fetched.
+class MessageRanges
+{
+public:
+    void insert(qint64 first, qint64 last);
+    void trim(qint64 first, qint64 last);
+    void clear() noexcept;
+
+    [[nodiscard]] bool isContiguous(qint64 first, qint64 last) const noexcept;
+
+    [[nodiscard]] int size() const noexcept;
+
+    [[nodiscard]] const std::vector<std::pair<qint64, qint64>> &values() const noexcept;
+
+private:
+    // Sorted and disjoint
+    std::vector<std::pair<qint64, qint64>> m_ranges;
+};
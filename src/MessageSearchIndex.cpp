@@ -0,0 +1,783 @@
+#include "MessageSearchIndex.hpp"
+
+#include "StorageManager.hpp"
+#include "Utils.hpp"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTimer>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <set>
+
+namespace {
+
+constexpr quint32 SegmentMagic = 0x4d475349;  // "MGSI"
+constexpr quint32 SegmentVersion = 2;
+
+// The segment is read in place, so all sections are laid out in native byte order and aligned
+struct SegmentHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 rangeCount;
+    quint32 termCount;
+    quint32 postingCount;
+    quint32 deletedCount;
+    quint32 stringLength;
+    quint32 messageCount;
+};
+
+struct SegmentRange
+{
+    qint64 first;
+    qint64 last;
+};
+
+// Sorted by id
+struct SegmentMessage
+{
+    qint64 id;
+    qint64 editDate;
+};
+
+struct SegmentTerm
+{
+    quint32 stringOffset;
+    quint32 stringLength;
+    quint32 postingOffset;
+    quint32 postingCount;
+};
+
+QString getSearchableText(const td::td_api::MessageContent &content)
+{
+    const td::td_api::formattedText *text = nullptr;
+
+    switch (content.get_id())
+    {
+        case td::td_api::messageText::ID:
+            text = static_cast<const td::td_api::messageText &>(content).text_.get();
+            break;
+        case td::td_api::messagePhoto::ID:
+            text = static_cast<const td::td_api::messagePhoto &>(content).caption_.get();
+            break;
+        case td::td_api::messageVideo::ID:
+            text = static_cast<const td::td_api::messageVideo &>(content).caption_.get();
+            break;
+        case td::td_api::messageDocument::ID:
+            text = static_cast<const td::td_api::messageDocument &>(content).caption_.get();
+            break;
+        case td::td_api::messageAudio::ID:
+            text = static_cast<const td::td_api::messageAudio &>(content).caption_.get();
+            break;
+        case td::td_api::messageAnimation::ID:
+            text = static_cast<const td::td_api::messageAnimation &>(content).caption_.get();
+            break;
+        case td::td_api::messageVoiceNote::ID:
+            text = static_cast<const td::td_api::messageVoiceNote &>(content).caption_.get();
+            break;
+        default:
+            break;
+    }
+
+    return text ? QString::fromStdString(text->text_) : QString();
+}
+
+}  // namespace
+
+// A segment file mapped into memory; terms are sorted, so prefix lookups are binary searches
+class MessageSearchIndex::Segment
+{
+public:
+    static std::unique_ptr<Segment> open(const QString &fileName)
+    {
+        auto segment = std::make_unique<Segment>();
+
+        segment->m_file.setFileName(fileName);
+        if (!segment->m_file.open(QIODevice::ReadOnly) || segment->m_file.size() < static_cast<qint64>(sizeof(SegmentHeader)))
+            return nullptr;
+
+        segment->m_size = segment->m_file.size();
+        segment->m_data = segment->m_file.map(0, segment->m_size);
+
+        if (!segment->m_data)
+            return nullptr;
+
+        // A damaged segment is dropped, its chat is indexed again as history loads
+        if (!segment->validate())
+        {
+            segment->m_file.unmap(const_cast<uchar *>(segment->m_data));
+            segment->m_file.remove();
+            return nullptr;
+        }
+
+        return segment;
+    }
+
+    [[nodiscard]] const SegmentHeader &header() const noexcept
+    {
+        return *reinterpret_cast<const SegmentHeader *>(m_data);
+    }
+
+    [[nodiscard]] const SegmentRange *ranges() const noexcept
+    {
+        return reinterpret_cast<const SegmentRange *>(m_data + sizeof(SegmentHeader));
+    }
+
+    [[nodiscard]] const SegmentMessage *messages() const noexcept
+    {
+        return reinterpret_cast<const SegmentMessage *>(ranges() + header().rangeCount);
+    }
+
+    [[nodiscard]] const SegmentTerm *terms() const noexcept
+    {
+        return reinterpret_cast<const SegmentTerm *>(messages() + header().messageCount);
+    }
+
+    [[nodiscard]] const qint64 *postings() const noexcept
+    {
+        return reinterpret_cast<const qint64 *>(terms() + header().termCount);
+    }
+
+    [[nodiscard]] const qint64 *deleted() const noexcept
+    {
+        return postings() + header().postingCount;
+    }
+
+    // A view on the mapped characters, nothing is copied
+    [[nodiscard]] QString term(const SegmentTerm &term) const
+    {
+        const auto *strings = reinterpret_cast<const QChar *>(deleted() + header().deletedCount);
+        return QString::fromRawData(strings + term.stringOffset, static_cast<int>(term.stringLength));
+    }
+
+    [[nodiscard]] const SegmentMessage *findMessage(qint64 messageId) const noexcept
+    {
+        const auto *end = messages() + header().messageCount;
+        const auto *it = std::lower_bound(messages(), end, messageId, [](const SegmentMessage &value, qint64 id) { return value.id < id; });
+
+        return it != end && it->id == messageId ? it : nullptr;
+    }
+
+    // Calls visit with the postings of every term starting with prefix
+    void forEachPrefix(const QString &prefix, const std::function<void(const qint64 *, quint32)> &visit) const
+    {
+        const auto *begin = terms();
+        const auto *end = begin + header().termCount;
+
+        auto it = std::lower_bound(begin, end, prefix, [this](const SegmentTerm &value, const QString &key) { return term(value) < key; });
+
+        for (; it != end && term(*it).startsWith(prefix); ++it)
+        {
+            visit(postings() + it->postingOffset, it->postingCount);
+        }
+    }
+
+private:
+    [[nodiscard]] bool validate() const noexcept
+    {
+        const auto &value = header();
+        if (value.magic != SegmentMagic || value.version != SegmentVersion)
+            return false;
+
+        const auto expected = sizeof(SegmentHeader) + value.rangeCount * sizeof(SegmentRange) + std::uint64_t(value.messageCount) * sizeof(SegmentMessage) +
+                              value.termCount * sizeof(SegmentTerm) +
+                              (std::uint64_t(value.postingCount) + value.deletedCount) * sizeof(qint64) + value.stringLength * sizeof(QChar);
+
+        if (expected != static_cast<std::uint64_t>(m_size))
+            return false;
+
+        for (quint32 i = 1; i < value.messageCount; ++i)
+        {
+            if (messages()[i - 1].id >= messages()[i].id)
+                return false;
+        }
+
+        // Lookups read postings and strings at the offsets the terms give, and binary search needs them in order
+        const auto *begin = terms();
+        const auto *end = begin + value.termCount;
+
+        for (const auto *it = begin; it != end; ++it)
+        {
+            if (std::uint64_t(it->postingOffset) + it->postingCount > value.postingCount ||
+                std::uint64_t(it->stringOffset) + it->stringLength > value.stringLength)
+                return false;
+
+            if (it != begin && !(term(*std::prev(it)) < term(*it)))
+                return false;
+        }
+
+        return true;
+    }
+
+    QFile m_file;
+    const uchar *m_data{};
+    qint64 m_size{};
+};
+
+MessageSearchIndex::MessageSearchIndex(StorageManager *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_client(store->client())
+    , m_backfillTimer(new QTimer(this))
+{
+    connect(m_client, SIGNAL(result(td::td_api::Object *)), this, SLOT(handleResult(td::td_api::Object *)));
+    connect(m_backfillTimer, SIGNAL(timeout()), this, SLOT(backfillNext()));
+
+    m_backfillTimer->setSingleShot(true);
+    m_backfillTimer->setInterval(BackfillInterval);
+
+    const auto names = QDir(directory()).entryList(QStringList() << "*.idx", QDir::Files);
+
+    for (const auto &name : names)
+    {
+        auto ok = false;
+        const auto chatId = QFileInfo(name).completeBaseName().toLongLong(&ok);
+
+        if (ok)
+            m_segments.insert(chatId);
+    }
+}
+
+MessageSearchIndex::~MessageSearchIndex()
+{
+    for (auto &[chatId, index] : m_chats)
+    {
+        if (index->dirty)
+            save(chatId, *index);
+    }
+}
+
+void MessageSearchIndex::addMessages(qint64 chatId, const std::vector<const td::td_api::message *> &messages, qint64 first, qint64 last)
+{
+    auto &index = chatIndex(chatId);
+
+    std::unordered_set<qint64> contained;
+    contained.reserve(messages.size());
+
+    for (const auto *message : messages)
+    {
+        contained.insert(message->id_);
+
+        // Messages of indexed spans are already in, unless they were edited while the client was not running
+        const auto indexed = editDate(index, message->id_);
+        if (indexed == message->edit_date_)
+            continue;
+
+        if (indexed)
+        {
+            reindex(index, message->id_, message->edit_date_, getSearchableText(*message->content_));
+            continue;
+        }
+
+        indexText(index, message->id_, getSearchableText(*message->content_));
+        index.editDates[message->id_] = message->edit_date_;
+    }
+
+    // A slice holds every message between its oldest and newest one, indexed messages it lacks were deleted meanwhile
+    if (messages.size() > 1)
+    {
+        const auto [oldest, newest] = std::ranges::minmax(messages | std::views::transform([](const auto *message) { return message->id_; }));
+
+        if (const auto *segment = index.segment.get())
+        {
+            const auto *end = segment->messages() + segment->header().messageCount;
+            const auto *it = std::lower_bound(segment->messages(), end, oldest, [](const SegmentMessage &value, qint64 id) { return value.id < id; });
+
+            for (; it != end && it->id <= newest; ++it)
+            {
+                if (!contained.contains(it->id))
+                    index.deleted.insert(it->id);
+            }
+        }
+
+        for (auto it = index.editDates.lower_bound(oldest); it != index.editDates.end() && it->first <= newest; ++it)
+        {
+            if (!contained.contains(it->first))
+                index.deleted.insert(it->first);
+        }
+    }
+
+    index.ranges.insert(first, last);
+    index.dirty = true;
+}
+
+std::vector<qint64> MessageSearchIndex::search(qint64 chatId, const QString &query, int limit)
+{
+    const auto words = Utils::tokenizeText(query);
+
+    if (words.isEmpty() || limit <= 0)
+        return {};
+
+    auto &index = chatIndex(chatId);
+
+    std::set<qint64, std::greater<>> result;
+
+    for (int i = 0; i < words.size(); ++i)
+    {
+        const auto &word = words.at(i);
+
+        std::set<qint64, std::greater<>> matches;
+
+        if (index.segment)
+        {
+            index.segment->forEachPrefix(word, [&](const qint64 *postings, quint32 count) {
+                for (quint32 j = 0; j < count; ++j)
+                {
+                    if (!index.deleted.contains(postings[j]) && !index.edited.contains(postings[j]))
+                        matches.insert(postings[j]);
+                }
+            });
+        }
+
+        for (auto it = index.delta.lower_bound(word); it != index.delta.end() && it->first.startsWith(word); ++it)
+        {
+            for (auto messageId : it->second)
+            {
+                if (!index.deleted.contains(messageId))
+                    matches.insert(messageId);
+            }
+        }
+
+        if (i == 0)
+        {
+            result = std::move(matches);
+        }
+        else
+        {
+            std::erase_if(result, [&matches](auto messageId) { return !matches.contains(messageId); });
+        }
+
+        if (result.empty())
+            return {};
+    }
+
+    std::vector<qint64> ids;
+    ids.reserve(std::min<std::size_t>(result.size(), limit));
+
+    for (auto it = result.begin(); it != result.end() && static_cast<int>(ids.size()) < limit; ++it)
+    {
+        ids.push_back(*it);
+    }
+
+    return ids;
+}
+
+qint64 MessageSearchIndex::unindexedFrom(qint64 chatId)
+{
+    const auto &ranges = chatIndex(chatId).ranges.values();
+    const auto *chat = m_store->chat(chatId);
+
+    // Only a span reaching the newest message spares TDLib the newer part of the history
+    if (ranges.empty() || !chat || !chat->last_message_ || ranges.back().second < chat->last_message_->id_)
+        return 0;
+
+    return ranges.back().first;
+}
+
+void MessageSearchIndex::setBackfillChat(qint64 chatId)
+{
+    if (m_backfillChatId == chatId)
+        return;
+
+    m_backfillChatId = chatId;
+    m_backfilled = 0;
+
+    if (chatId != 0)
+        m_backfillTimer->start();
+    else
+        m_backfillTimer->stop();
+}
+
+void MessageSearchIndex::flush(qint64 chatId)
+{
+    auto it = m_chats.find(chatId);
+    if (it == m_chats.end())
+        return;
+
+    if (it->second->dirty)
+        save(chatId, *it->second);
+
+    // The segment is mapped again when the chat is searched or opened
+    if (chatId != m_backfillChatId)
+        m_chats.erase(it);
+}
+
+void MessageSearchIndex::handleResult(td::td_api::Object *object)
+{
+    switch (object->get_id())
+    {
+        case td::td_api::updateDeleteMessages::ID: {
+            const auto &update = static_cast<const td::td_api::updateDeleteMessages &>(*object);
+
+            if (auto *index = update.from_cache_ ? nullptr : loadedChatIndex(update.chat_id_))
+            {
+                index->deleted.insert(update.message_ids_.begin(), update.message_ids_.end());
+                index->dirty = true;
+            }
+            break;
+        }
+        case td::td_api::updateMessageContent::ID: {
+            const auto &update = static_cast<const td::td_api::updateMessageContent &>(*object);
+
+            // Connected before any model, so the content has not been moved out of the update yet
+            auto *index = loadedChatIndex(update.chat_id_);
+            if (!index || !update.new_content_)
+                break;
+
+            // Without the segment it is not known whether the message is indexed, indexing it anyway only adds a correct posting;
+            // the edit date follows with updateMessageEdited
+            const auto indexed = index->opened ? editDate(*index, update.message_id_) : std::optional<qint32>(0);
+            if (!indexed)
+                break;
+
+            reindex(*index, update.message_id_, *indexed, getSearchableText(*update.new_content_));
+            break;
+        }
+        case td::td_api::updateMessageEdited::ID: {
+            const auto &update = static_cast<const td::td_api::updateMessageEdited &>(*object);
+
+            if (auto *index = loadedChatIndex(update.chat_id_))
+            {
+                if (auto it = index->editDates.find(update.message_id_); it != index->editDates.end())
+                {
+                    it->second = update.edit_date_;
+                    index->dirty = true;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void MessageSearchIndex::handleBackfill(td::td_api::Object *object, qint64 chatId, qint64 fromMessageId)
+{
+    td::td_api::object_ptr<td::td_api::Object> response(object);
+
+    m_backfillInFlight = false;
+
+    if (chatId != m_backfillChatId || response->get_id() != td::td_api::messages::ID)
+        return;
+
+    auto result = td::move_tl_object_as<td::td_api::messages>(response);
+
+    std::vector<const td::td_api::message *> messages;
+    auto older = 0;
+
+    for (const auto &message : result->messages_)
+    {
+        if (!message)
+            continue;
+
+        messages.push_back(message.get());
+
+        // With offset 0 the reply starts with the message backfill started from
+        if (message->id_ < fromMessageId)
+            ++older;
+    }
+
+    // The local database ends here, once nothing older than the span comes back
+    if (older == 0)
+        return;
+
+    const auto oldest = std::ranges::min(messages, std::ranges::less{}, &td::td_api::message::id_)->id_;
+
+    addMessages(chatId, messages, oldest, fromMessageId);
+
+    m_backfilled += older;
+
+    if (m_backfilled < BackfillMessageLimit)
+        m_backfillTimer->start();
+}
+
+void MessageSearchIndex::backfillNext()
+{
+    if (m_backfillChatId == 0 || m_backfillInFlight)
+        return;
+
+    // Interactive requests go first
+    if (m_client->pendingRequestCount() > 0)
+    {
+        m_backfillTimer->start();
+        return;
+    }
+
+    // Backfill extends the newest indexed span downwards, it starts once the chat has been loaded
+    const auto &ranges = chatIndex(m_backfillChatId).ranges.values();
+    if (ranges.empty())
+    {
+        m_backfillTimer->start();
+        return;
+    }
+
+    const auto fromMessageId = ranges.back().first;
+
+    auto request = td::td_api::make_object<td::td_api::getChatHistory>();
+    request->chat_id_ = m_backfillChatId;
+    request->from_message_id_ = fromMessageId;
+    request->offset_ = 0;
+    request->limit_ = BackfillSliceLimit;
+    request->only_local_ = true;
+
+    m_backfillInFlight = true;
+
+    m_client->send(
+        std::move(request),
+        [this, chatId = m_backfillChatId, fromMessageId](auto &&response) {
+            QMetaObject::invokeMethod(this, "handleBackfill", Qt::QueuedConnection, Q_ARG(td::td_api::Object *, response.release()), Q_ARG(qint64, chatId),
+                                      Q_ARG(qint64, fromMessageId));
+        },
+        true);
+}
+
+MessageSearchIndex::ChatIndex &MessageSearchIndex::chatIndex(qint64 chatId)
+{
+    auto &index = m_chats[chatId];
+
+    if (!index)
+        index = std::make_unique<ChatIndex>();
+
+    openSegment(chatId, *index);
+
+    return *index;
+}
+
+MessageSearchIndex::ChatIndex *MessageSearchIndex::loadedChatIndex(qint64 chatId)
+{
+    if (auto it = m_chats.find(chatId); it != m_chats.end())
+        return it->second.get();
+
+    // Updates for chats not open only matter when they have a segment, they are kept until it is merged
+    if (!m_segments.contains(chatId))
+        return nullptr;
+
+    return m_chats.emplace(chatId, std::make_unique<ChatIndex>()).first->second.get();
+}
+
+void MessageSearchIndex::openSegment(qint64 chatId, ChatIndex &index)
+{
+    if (std::exchange(index.opened, true) || !m_segments.contains(chatId))
+        return;
+
+    index.segment = Segment::open(fileName(chatId));
+
+    const auto *segment = index.segment.get();
+    if (!segment)
+    {
+        m_segments.erase(chatId);
+        return;
+    }
+
+    for (quint32 i = 0; i < segment->header().rangeCount; ++i)
+    {
+        index.ranges.insert(segment->ranges()[i].first, segment->ranges()[i].last);
+    }
+
+    index.deleted.insert(segment->deleted(), segment->deleted() + segment->header().deletedCount);
+}
+
+std::optional<qint32> MessageSearchIndex::editDate(const ChatIndex &index, qint64 messageId)
+{
+    if (index.deleted.contains(messageId))
+        return std::nullopt;
+
+    if (auto it = index.editDates.find(messageId); it != index.editDates.end())
+        return it->second;
+
+    if (const auto *message = index.segment ? index.segment->findMessage(messageId) : nullptr)
+        return static_cast<qint32>(message->editDate);
+
+    return std::nullopt;
+}
+
+void MessageSearchIndex::indexText(ChatIndex &index, qint64 messageId, const QString &text)
+{
+    auto terms = Utils::tokenizeText(text);
+
+    terms.removeDuplicates();
+
+    for (const auto &term : terms)
+    {
+        index.delta[term].push_back(messageId);
+    }
+
+    index.dirty = true;
+}
+
+void MessageSearchIndex::reindex(ChatIndex &index, qint64 messageId, qint32 editDate, const QString &text)
+{
+    // Stale delta postings are dropped right away, stale segment ones are filtered until the next merge
+    for (auto &[term, postings] : index.delta)
+    {
+        std::erase(postings, messageId);
+    }
+
+    std::erase_if(index.delta, [](const auto &value) { return value.second.empty(); });
+
+    indexText(index, messageId, text);
+
+    index.editDates[messageId] = editDate;
+    index.edited.insert(messageId);
+}
+
+void MessageSearchIndex::save(qint64 chatId, ChatIndex &index)
+{
+    openSegment(chatId, index);
+
+    // Segment and delta messages and terms are all sorted, so each merge takes one pass
+    std::vector<SegmentMessage> messages;
+
+    const auto *segment = index.segment.get();
+
+    if (segment)
+    {
+        std::copy_if(segment->messages(), segment->messages() + segment->header().messageCount, std::back_inserter(messages), [&index](const auto &message) {
+            return !index.deleted.contains(message.id) && !index.editDates.contains(message.id);
+        });
+    }
+
+    const auto segmentMessageCount = static_cast<std::ptrdiff_t>(messages.size());
+
+    for (const auto &[messageId, date] : index.editDates)
+    {
+        if (!index.deleted.contains(messageId))
+            messages.push_back({messageId, date});
+    }
+
+    std::ranges::inplace_merge(messages, messages.begin() + segmentMessageCount, std::ranges::less{}, &SegmentMessage::id);
+
+    std::vector<std::pair<QString, std::vector<qint64>>> terms;
+
+    const auto keep = [&index](qint64 messageId) { return !index.deleted.contains(messageId) && !index.edited.contains(messageId); };
+
+    quint32 segmentTerm = 0;
+    const auto segmentTermCount = segment ? segment->header().termCount : 0;
+
+    auto delta = index.delta.begin();
+
+    while (segmentTerm < segmentTermCount || delta != index.delta.end())
+    {
+        std::vector<qint64> postings;
+        QString term;
+
+        const auto fromSegment = segmentTerm < segmentTermCount &&
+                                 (delta == index.delta.end() || segment->term(segment->terms()[segmentTerm]) <= delta->first);
+
+        if (fromSegment)
+        {
+            const auto &value = segment->terms()[segmentTerm++];
+
+            // Copied, the mapping goes away once the new segment is written
+            term = QString(segment->term(value).constData(), static_cast<int>(value.stringLength));
+
+            std::copy_if(segment->postings() + value.postingOffset, segment->postings() + value.postingOffset + value.postingCount, std::back_inserter(postings),
+                         keep);
+        }
+
+        if (delta != index.delta.end() && (!fromSegment || delta->first == term))
+        {
+            if (!fromSegment)
+                term = delta->first;
+
+            std::copy_if(delta->second.begin(), delta->second.end(), std::back_inserter(postings),
+                         [&index](qint64 messageId) { return !index.deleted.contains(messageId); });
+            ++delta;
+        }
+
+        std::ranges::sort(postings, std::greater<>{});
+        postings.erase(std::ranges::unique(postings).begin(), postings.end());
+
+        if (!postings.empty())
+            terms.emplace_back(std::move(term), std::move(postings));
+    }
+
+    SegmentHeader header{};
+    header.magic = SegmentMagic;
+    header.version = SegmentVersion;
+    header.rangeCount = static_cast<quint32>(index.ranges.values().size());
+    header.messageCount = static_cast<quint32>(messages.size());
+    header.termCount = static_cast<quint32>(terms.size());
+
+    std::vector<SegmentTerm> table;
+    table.reserve(terms.size());
+
+    for (const auto &[term, postings] : terms)
+    {
+        table.push_back({header.stringLength, static_cast<quint32>(term.size()), header.postingCount, static_cast<quint32>(postings.size())});
+
+        header.stringLength += term.size();
+        header.postingCount += postings.size();
+    }
+
+    QDir().mkpath(QFileInfo(fileName(chatId)).absolutePath());
+
+    const auto temporaryName = fileName(chatId) + ".tmp";
+
+    QFile file(temporaryName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    // Deleted ids are all dropped from the postings, they do not need to be carried over
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (const auto &[first, last] : index.ranges.values())
+    {
+        const SegmentRange range{first, last};
+        file.write(reinterpret_cast<const char *>(&range), sizeof(range));
+    }
+
+    file.write(reinterpret_cast<const char *>(messages.data()), static_cast<qint64>(messages.size() * sizeof(SegmentMessage)));
+
+    file.write(reinterpret_cast<const char *>(table.data()), static_cast<qint64>(table.size() * sizeof(SegmentTerm)));
+
+    for (const auto &[term, postings] : terms)
+    {
+        file.write(reinterpret_cast<const char *>(postings.data()), static_cast<qint64>(postings.size() * sizeof(qint64)));
+    }
+
+    for (const auto &[term, postings] : terms)
+    {
+        file.write(reinterpret_cast<const char *>(term.constData()), static_cast<qint64>(term.size() * sizeof(QChar)));
+    }
+
+    if (!file.flush() || file.error() != QFile::NoError)
+    {
+        file.remove();
+        return;
+    }
+
+    file.close();
+
+    index.segment.reset();
+
+    QFile::remove(fileName(chatId));
+    QFile::rename(temporaryName, fileName(chatId));
+
+    index.segment = Segment::open(fileName(chatId));
+
+    if (index.segment)
+        m_segments.insert(chatId);
+    else
+        m_segments.erase(chatId);
+
+    index.delta.clear();
+    index.editDates.clear();
+    index.deleted.clear();
+    index.edited.clear();
+    index.dirty = false;
+}
+
+QString MessageSearchIndex::directory()
+{
+    return QDir::homePath() + "/.meegram/search";
+}
+
+QString MessageSearchIndex::fileName(qint64 chatId)
+{
+    return directory() + "/" + QString::number(chatId) + ".idx";
+}
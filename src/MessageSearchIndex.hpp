@@ -0,0 +1,115 @@
+#pragma once
+
+#include "MessageRanges.hpp"
+
+#include <td/telegram/td_api.h>
+
+#include <QFile>
+#include <QObject>
+#include <QString>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Client;
+class QTimer;
+class StorageManager;
+
+// On-device full-text index over the messages of each chat. Terms are folded like the chat
+// search index and matched by prefix. Every chat has an immutable segment file that is
+// memory-mapped and searched in place, plus an in-memory delta of what was indexed since;
+// the two are merged into a new segment when the chat is closed. Indexed spans of history
+// are tracked as ranges, so that a search knows from where TDLib has to be asked instead,
+// and the edit date of every indexed message, so that reloaded history is checked against it.
+class MessageSearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MessageSearchIndex(StorageManager *store, QObject *parent = nullptr);
+    ~MessageSearchIndex() override;
+
+    // Indexes one contiguous slice [first, last] of a chat's history
+    void addMessages(qint64 chatId, const std::vector<const td::td_api::message *> &messages, qint64 first, qint64 last);
+
+    // Ids of matching messages, newest first; every word of the query has to prefix match
+    [[nodiscard]] std::vector<qint64> search(qint64 chatId, const QString &query, int limit);
+
+    // The message TDLib has to be searched from for what the index does not hold, 0 for the whole chat
+    [[nodiscard]] qint64 unindexedFrom(qint64 chatId);
+
+    // Reads the local history of the chat into the index while the client is idle, 0 to stop
+    void setBackfillChat(qint64 chatId);
+
+    // Merges the delta of a chat into its segment file and unloads the chat
+    void flush(qint64 chatId);
+
+private slots:
+    void handleResult(td::td_api::Object *object);
+    void handleBackfill(td::td_api::Object *object, qint64 chatId, qint64 fromMessageId);
+
+    void backfillNext();
+
+private:
+    static constexpr auto BackfillInterval = 500;  // msec
+    static constexpr auto BackfillSliceLimit = 100;
+    static constexpr auto BackfillMessageLimit = 2000;
+
+    class Segment;
+
+    struct ChatIndex
+    {
+        std::unique_ptr<Segment> segment;
+
+        // Terms indexed since the segment was written
+        std::map<QString, std::vector<qint64>> delta;
+
+        // Edit dates of the messages indexed since the segment was written
+        std::map<qint64, qint32> editDates;
+
+        // Segment postings of these messages no longer hold, the edited ones are in the delta again
+        std::unordered_set<qint64> deleted;
+        std::unordered_set<qint64> edited;
+
+        MessageRanges ranges;
+
+        // Updates of chats that are not open are recorded before the segment is mapped
+        bool opened = false;
+        bool dirty = false;
+    };
+
+    ChatIndex &chatIndex(qint64 chatId);
+    [[nodiscard]] ChatIndex *loadedChatIndex(qint64 chatId);
+
+    void openSegment(qint64 chatId, ChatIndex &index);
+
+    // Edit date of an indexed message, none for messages the index does not hold
+    [[nodiscard]] static std::optional<qint32> editDate(const ChatIndex &index, qint64 messageId);
+
+    static void indexText(ChatIndex &index, qint64 messageId, const QString &text);
+    static void reindex(ChatIndex &index, qint64 messageId, qint32 editDate, const QString &text);
+
+    void save(qint64 chatId, ChatIndex &index);
+
+    [[nodiscard]] static QString directory();
+    [[nodiscard]] static QString fileName(qint64 chatId);
+
+    StorageManager *m_store{};
+    Client *m_client{};
+
+    QTimer *m_backfillTimer;
+
+    qint64 m_backfillChatId{};
+    int m_backfilled{};
+    bool m_backfillInFlight = false;
+
+    std::unordered_map<qint64, std::unique_ptr<ChatIndex>> m_chats;
+
+    // Chats with a segment file, listed once so that updates do not look at the disk
+    std::unordered_set<qint64> m_segments;
+};
@@ -0,0 +1,203 @@
+#include "NavigationIndex.hpp"
+
+#include "StorageManager.hpp"
+
+#include <iterator>
+
+NavigationIndex::NavigationIndex(StorageManager *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_client(store->client())
+{
+    connect(m_client, SIGNAL(result(td::td_api::Object *)), this, SLOT(handleResult(td::td_api::Object *)));
+}
+
+void NavigationIndex::load(qint64 chatId)
+{
+    auto &entry = m_entries[chatId];
+
+    if (!entry.mentionsLoaded && !entry.mentionsRequested)
+    {
+        // A chat without unread mentions is known without asking
+        if (const auto *chat = m_store->chat(chatId); chat && chat->unread_mention_count_ == 0)
+            entry.mentionsLoaded = true;
+        else
+            request(chatId, MentionList);
+    }
+
+    if (!entry.pinnedLoaded && !entry.pinnedRequested)
+        request(chatId, PinnedList);
+}
+
+qint64 NavigationIndex::nextMention(qint64 chatId, qint64 afterMessageId) const
+{
+    auto it = m_entries.find(chatId);
+    if (it == m_entries.end() || it->second.mentions.empty())
+        return 0;
+
+    const auto &mentions = it->second.mentions;
+
+    if (auto next = mentions.upper_bound(afterMessageId); next != mentions.end())
+        return *next;
+
+    return *mentions.begin();
+}
+
+qint64 NavigationIndex::nextPinned(qint64 chatId, qint64 beforeMessageId) const
+{
+    auto it = m_entries.find(chatId);
+    if (it == m_entries.end() || it->second.pinned.empty())
+        return 0;
+
+    const auto &pinned = it->second.pinned;
+
+    if (auto next = pinned.lower_bound(beforeMessageId); next != pinned.begin())
+        return *std::prev(next);
+
+    return *pinned.rbegin();
+}
+
+int NavigationIndex::pinnedCount(qint64 chatId) const
+{
+    auto it = m_entries.find(chatId);
+    return it != m_entries.end() ? static_cast<int>(it->second.pinned.size()) : 0;
+}
+
+void NavigationIndex::handleResult(td::td_api::Object *object)
+{
+    // Only chats that have been looked up are followed
+    const auto entry = [this](qint64 chatId) -> Entry * {
+        auto it = m_entries.find(chatId);
+        return it != m_entries.end() ? &it->second : nullptr;
+    };
+
+    switch (object->get_id())
+    {
+        case td::td_api::updateNewMessage::ID: {
+            const auto &message = *static_cast<const td::td_api::updateNewMessage &>(*object).message_;
+
+            if (auto *value = entry(message.chat_id_); value && message.contains_unread_mention_)
+            {
+                value->mentions.insert(message.id_);
+                emit indexChanged(message.chat_id_);
+            }
+            break;
+        }
+        case td::td_api::updateMessageMentionRead::ID: {
+            const auto &update = static_cast<const td::td_api::updateMessageMentionRead &>(*object);
+
+            if (auto *value = entry(update.chat_id_))
+            {
+                value->mentions.erase(update.message_id_);
+                emit indexChanged(update.chat_id_);
+            }
+            break;
+        }
+        case td::td_api::updateChatUnreadMentionCount::ID: {
+            const auto &update = static_cast<const td::td_api::updateChatUnreadMentionCount &>(*object);
+
+            auto *value = entry(update.chat_id_);
+            if (!value || !value->mentionsLoaded)
+                break;
+
+            // Mentions read elsewhere all at once, or ones the updates above did not account for
+            if (update.unread_mention_count_ == 0)
+                value->mentions.clear();
+            else if (update.unread_mention_count_ != static_cast<int>(value->mentions.size()))
+                value->mentionsLoaded = false;
+
+            emit indexChanged(update.chat_id_);
+            break;
+        }
+        case td::td_api::updateMessageIsPinned::ID: {
+            const auto &update = static_cast<const td::td_api::updateMessageIsPinned &>(*object);
+
+            if (auto *value = entry(update.chat_id_))
+            {
+                if (update.is_pinned_)
+                    value->pinned.insert(update.message_id_);
+                else
+                    value->pinned.erase(update.message_id_);
+
+                emit indexChanged(update.chat_id_);
+            }
+            break;
+        }
+        case td::td_api::updateDeleteMessages::ID: {
+            const auto &update = static_cast<const td::td_api::updateDeleteMessages &>(*object);
+
+            auto *value = update.from_cache_ ? nullptr : entry(update.chat_id_);
+            if (!value)
+                break;
+
+            for (auto messageId : update.message_ids_)
+            {
+                value->mentions.erase(messageId);
+                value->pinned.erase(messageId);
+            }
+
+            emit indexChanged(update.chat_id_);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void NavigationIndex::handleFound(td::td_api::Object *object, qint64 chatId, int list)
+{
+    td::td_api::object_ptr<td::td_api::Object> response(object);
+
+    auto &entry = m_entries[chatId];
+
+    (list == MentionList ? entry.mentionsRequested : entry.pinnedRequested) = false;
+
+    if (response->get_id() != td::td_api::foundChatMessages::ID)
+        return;
+
+    const auto result = td::move_tl_object_as<td::td_api::foundChatMessages>(response);
+
+    std::set<qint64> ids;
+
+    for (const auto &message : result->messages_)
+    {
+        if (message)
+            ids.insert(message->id_);
+    }
+
+    // Ids beyond the first page are rare enough to be picked up by the next lookup of the chat
+    if (list == MentionList)
+    {
+        entry.mentions = std::move(ids);
+        entry.mentionsLoaded = true;
+    }
+    else
+    {
+        entry.pinned = std::move(ids);
+        entry.pinnedLoaded = true;
+    }
+
+    emit indexChanged(chatId);
+}
+
+void NavigationIndex::request(qint64 chatId, List list)
+{
+    auto request = td::td_api::make_object<td::td_api::searchChatMessages>();
+    request->chat_id_ = chatId;
+    request->from_message_id_ = 0;
+    request->offset_ = 0;
+    request->limit_ = SearchLimit;
+
+    if (list == MentionList)
+        request->filter_ = td::td_api::make_object<td::td_api::searchMessagesFilterUnreadMention>();
+    else
+        request->filter_ = td::td_api::make_object<td::td_api::searchMessagesFilterPinned>();
+
+    auto &entry = m_entries[chatId];
+    (list == MentionList ? entry.mentionsRequested : entry.pinnedRequested) = true;
+
+    m_client->send(std::move(request), [this, chatId, list](auto &&response) {
+        QMetaObject::invokeMethod(this, "handleFound", Qt::QueuedConnection, Q_ARG(td::td_api::Object *, response.release()), Q_ARG(qint64, chatId),
+                                  Q_ARG(int, list));
+    });
+}
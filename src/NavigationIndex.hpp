@@ -0,0 +1,66 @@
+#pragma once
+
+#include <td/telegram/td_api.h>
+
+#include <QObject>
+
+#include <set>
+#include <unordered_map>
+
+class Client;
+class StorageManager;
+
+// Unread mentions and pinned messages of each chat, kept current from updates once a chat
+// has been looked up, so that jumping to the next one needs no search round trip.
+class NavigationIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NavigationIndex(StorageManager *store, QObject *parent = nullptr);
+
+    // Requests whichever list of the chat is not known yet
+    void load(qint64 chatId);
+
+    // The oldest unread mention after the given message, wrapping around; 0 when there is none
+    [[nodiscard]] qint64 nextMention(qint64 chatId, qint64 afterMessageId) const;
+
+    // The newest pinned message before the given message, wrapping around; 0 when there is none
+    [[nodiscard]] qint64 nextPinned(qint64 chatId, qint64 beforeMessageId) const;
+
+    [[nodiscard]] int pinnedCount(qint64 chatId) const;
+
+signals:
+    void indexChanged(qint64 chatId);
+
+private slots:
+    void handleResult(td::td_api::Object *object);
+    void handleFound(td::td_api::Object *object, qint64 chatId, int list);
+
+private:
+    static constexpr auto SearchLimit = 100;
+
+    enum List {
+        MentionList,
+        PinnedList,
+    };
+
+    struct Entry
+    {
+        std::set<qint64> mentions;
+        std::set<qint64> pinned;
+
+        bool mentionsLoaded = false;
+        bool pinnedLoaded = false;
+
+        bool mentionsRequested = false;
+        bool pinnedRequested = false;
+    };
+
+    void request(qint64 chatId, List list);
+
+    StorageManager *m_store{};
+    Client *m_client{};
+
+    std::unordered_map<qint64, Entry> m_entries;
+};
@@ -0,0 +1,84 @@
+#include "ReadReceipts.hpp"
+
+#include "Client.hpp"
+
+#include <QTimer>
+
+#include <algorithm>
+#include <utility>
+
+ReadReceipts::ReadReceipts(Client *client, QObject *parent)
+    : QObject(parent)
+    , m_client(client)
+    , m_timer(new QTimer(this))
+{
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(flush()));
+
+    // Not restarted by later reports, so a busy chat is still reported every window
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(FlushInterval);
+}
+
+void ReadReceipts::add(qint64 chatId, const std::vector<std::int64_t> &messageIds)
+{
+    auto &viewed = m_viewed[chatId];
+    auto &pending = m_pending[chatId];
+
+    const auto pendingCount = pending.size();
+
+    for (auto id : messageIds)
+    {
+        if (viewed.insert(id).second)
+            pending.push_back(id);
+    }
+
+    if (pending.size() == pendingCount)
+        return;
+
+    ++m_reportCount;
+
+    if (!m_timer->isActive())
+        m_timer->start();
+}
+
+void ReadReceipts::forget(qint64 chatId)
+{
+    m_viewed.erase(chatId);
+}
+
+int ReadReceipts::reportCount() const noexcept
+{
+    return m_reportCount;
+}
+
+int ReadReceipts::requestCount() const noexcept
+{
+    return m_requestCount;
+}
+
+int ReadReceipts::avoidedRequestCount() const noexcept
+{
+    return m_reportCount - m_requestCount;
+}
+
+void ReadReceipts::flush()
+{
+    m_timer->stop();
+
+    for (auto &[chatId, messageIds] : std::exchange(m_pending, {}))
+    {
+        if (messageIds.empty())
+            continue;
+
+        std::ranges::sort(messageIds);
+
+        auto request = td::td_api::make_object<td::td_api::viewMessages>();
+        request->chat_id_ = chatId;
+        request->message_ids_ = std::move(messageIds);
+        request->force_read_ = true;
+
+        m_client->send(std::move(request), {});
+
+        ++m_requestCount;
+    }
+}
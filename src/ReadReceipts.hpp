@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QObject>
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Client;
+class QTimer;
+
+// Collects the ids of messages that have been on screen and reports them with one
+// viewMessages request per chat per window. Ids already reported are not sent again.
+class ReadReceipts : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ReadReceipts(Client *client, QObject *parent = nullptr);
+
+    void add(qint64 chatId, const std::vector<std::int64_t> &messageIds);
+
+    // Drops what is known of a closed chat; ids viewed again after it is reopened are reported once more
+    void forget(qint64 chatId);
+
+    // Reports that the per-message requests would have cost, and what was actually sent
+    [[nodiscard]] int reportCount() const noexcept;
+    [[nodiscard]] int requestCount() const noexcept;
+    [[nodiscard]] int avoidedRequestCount() const noexcept;
+
+public slots:
+    void flush();
+
+private:
+    static constexpr auto FlushInterval = 300;  // msec
+
+    Client *m_client{};
+
+    QTimer *m_timer;
+
+    int m_reportCount{};
+    int m_requestCount{};
+
+    std::unordered_map<qint64, std::vector<std::int64_t>> m_pending;
+    std::unordered_map<qint64, std::unordered_set<std::int64_t>> m_viewed;
+};
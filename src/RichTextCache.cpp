@@ -0,0 +1,83 @@
+#include "RichTextCache.hpp"
+
+#include <functional>
+
+const QString *RichTextCache::find(const Key &key)
+{
+    auto it = m_index.find(key);
+    if (it == m_index.end())
+    {
+        ++m_misses;
+        return nullptr;
+    }
+
+    ++m_hits;
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return &it->second->second;
+}
+
+bool RichTextCache::contains(const Key &key) const
+{
+    return m_index.contains(key);
+}
+
+void RichTextCache::insert(const Key &key, QString text)
+{
+    if (auto it = m_index.find(key); it != m_index.end())
+    {
+        it->second->second = std::move(text);
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+
+    m_entries.emplace_front(key, std::move(text));
+    m_index.emplace(key, m_entries.begin());
+
+    if (m_entries.size() > Capacity)
+    {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+}
+
+void RichTextCache::remove(const Key &key)
+{
+    if (auto it = m_index.find(key); it != m_index.end())
+    {
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+}
+
+void RichTextCache::rename(const Key &from, const Key &to)
+{
+    auto node = m_index.extract(from);
+    if (!node)
+        return;
+
+    remove(to);
+
+    node.mapped()->first = to;
+    node.key() = to;
+    m_index.insert(std::move(node));
+}
+
+int RichTextCache::hitCount() const noexcept
+{
+    return m_hits;
+}
+
+int RichTextCache::missCount() const noexcept
+{
+    return m_misses;
+}
+
+std::size_t RichTextCache::KeyHash::operator()(const Key &key) const noexcept
+{
+    // Message ids are unique across chats only together with the chat id
+    auto hash = std::hash<qint64>{}(key.messageId);
+    hash ^= std::hash<qint64>{}(key.chatId) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<qint32>{}(key.editDate) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
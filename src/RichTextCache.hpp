@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QString>
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// Rich text of messages keyed by the version of the message it was built from, so that a
+// message is formatted once however often its delegate is recreated. The least recently
+// used entries are dropped first.
+class RichTextCache
+{
+public:
+    struct Key
+    {
+        qint64 chatId{};
+        qint64 messageId{};
+        qint32 editDate{};
+
+        bool operator==(const Key &) const noexcept = default;
+    };
+
+    [[nodiscard]] const QString *find(const Key &key);
+    [[nodiscard]] bool contains(const Key &key) const;
+
+    void insert(const Key &key, QString text);
+    void remove(const Key &key);
+
+    // Files the text of one version under another, for edits that did not change it
+    void rename(const Key &from, const Key &to);
+
+    [[nodiscard]] int hitCount() const noexcept;
+    [[nodiscard]] int missCount() const noexcept;
+
+private:
+    static constexpr std::size_t Capacity = 2000;
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key &key) const noexcept;
+    };
+
+    using Entries = std::list<std::pair<Key, QString>>;
+
+    // Most recently used first
+    Entries m_entries;
+    std::unordered_map<Key, Entries::iterator, KeyHash> m_index;
+
+    int m_hits{};
+    int m_misses{};
+};
@@ -12,6 +12,7 @@ Settings::Settings(QObject *parent)
 {
     m_languagePackId = m_settings->value("languagePackId", DefaultLanguageCode).toString();
     m_languagePluralId = m_settings->value("languagePluralId", DefaultLanguageCode).toString();
+    m_messageCacheOnDisk = m_settings->value("messageCacheOnDisk", true).toBool();
 }
 
 QString Settings::languagePackId() const
@@ -43,3 +44,18 @@ void Settings::setLanguagePluralId(const QString &value)
         emit languagePluralIdChanged();
     }
 }
+
+bool Settings::messageCacheOnDisk() const
+{
+    return m_messageCacheOnDisk;
+}
+
+void Settings::setMessageCacheOnDisk(bool value)
+{
+    if (m_messageCacheOnDisk != value)
+    {
+        m_messageCacheOnDisk = value;
+        m_settings->setValue("messageCacheOnDisk", m_messageCacheOnDisk);
+        emit messageCacheOnDiskChanged();
+    }
+}
@@ -10,6 +10,7 @@ class Settings : public QObject
     Q_OBJECT
     Q_PROPERTY(QString languagePackId READ languagePackId WRITE setLanguagePackId NOTIFY languagePackIdChanged)
     Q_PROPERTY(QString languagePluralId READ languagePluralId WRITE setLanguagePluralId NOTIFY languagePluralIdChanged)
+    Q_PROPERTY(bool messageCacheOnDisk READ messageCacheOnDisk WRITE setMessageCacheOnDisk NOTIFY messageCacheOnDiskChanged)
 
 public:
     explicit Settings(QObject *parent = nullptr);
@@ -20,14 +21,19 @@ public:
     QString languagePluralId() const;
     void setLanguagePluralId(const QString &value);
 
+    bool messageCacheOnDisk() const;
+    void setMessageCacheOnDisk(bool value);
 
 signals:
     void languagePackIdChanged();
     void languagePluralIdChanged();
+    void messageCacheOnDiskChanged();
 
 private:
     QSettings *m_settings;
 
     QString m_languagePackId;
     QString m_languagePluralId;
+
+    bool m_messageCacheOnDisk;
 };
@@ -10,6 +10,13 @@ StorageManager::StorageManager()
     : m_client(std::make_unique<Client>())
     , m_locale(std::make_unique<Locale>())
     , m_settings(std::make_unique<Settings>())
+    , m_chatActionTracker(std::make_unique<ChatActionTracker>(this))
+    , m_dateBuckets(std::make_unique<DateBuckets>(this))
+    , m_historyPrefetcher(std::make_unique<HistoryPrefetcher>(this))
+    , m_messagePageCache(std::make_unique<MessagePageCache>(this))
+    , m_messageSearchIndex(std::make_unique<MessageSearchIndex>(this))
+    , m_navigationIndex(std::make_unique<NavigationIndex>(this))
+    , m_richTextCache(std::make_unique<RichTextCache>())
 {
     connect(m_client.get(), SIGNAL(result(td::td_api::Object *)), this, SLOT(handleResult(td::td_api::Object *)));
 }
@@ -20,16 +27,51 @@ StorageManager &StorageManager::instance()
     return staticObject;
 }
 
+ChatActionTracker *StorageManager::chatActionTracker() const noexcept
+{
+    return m_chatActionTracker.get();
+}
+
 Client *StorageManager::client() const noexcept
 {
     return m_client.get();
 }
 
+DateBuckets *StorageManager::dateBuckets() const noexcept
+{
+    return m_dateBuckets.get();
+}
+
+HistoryPrefetcher *StorageManager::historyPrefetcher() const noexcept
+{
+    return m_historyPrefetcher.get();
+}
+
 Locale *StorageManager::locale() const noexcept
 {
     return m_locale.get();
 }
 
+MessagePageCache *StorageManager::messagePageCache() const noexcept
+{
+    return m_messagePageCache.get();
+}
+
+MessageSearchIndex *StorageManager::messageSearchIndex() const noexcept
+{
+    return m_messageSearchIndex.get();
+}
+
+NavigationIndex *StorageManager::navigationIndex() const noexcept
+{
+    return m_navigationIndex.get();
+}
+
+RichTextCache *StorageManager::richTextCache() const noexcept
+{
+    return m_richTextCache.get();
+}
+
 Settings *StorageManager::settings() const noexcept
 {
     return m_settings.get();
@@ -41,6 +83,11 @@ std::vector<int64_t> StorageManager::chatIds() const noexcept
     return std::vector<int64_t>(view.begin(), view.end());
 }
 
+const ChatSearchIndex &StorageManager::chatSearchIndex() const noexcept
+{
+    return m_chatSearchIndex;
+}
+
 const td::td_api::basicGroup *StorageManager::basicGroup(qint64 groupId) const noexcept
 {
     return getPointer(m_basicGroup, groupId);
@@ -133,33 +180,37 @@ void StorageManager::handleResult(td::td_api::Object *object)
     td::td_api::downcast_call(
         *object,
         detail::Overloaded{
-            [this](td::td_api::updateNewChat &value) { m_chats.emplace(value.chat_->id_, std::move(value.chat_)); },
+            [this](td::td_api::updateNewChat &value) {
+                indexChat(*value.chat_);
+                m_chats.emplace(value.chat_->id_, std::move(value.chat_));
+            },
             [this](td::td_api::updateChatTitle &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->title_ = value.title_;
-                    emit chatItemUpdated(value.chat_id_);
+                    indexChat(*it->second);
+                    emit chatItemUpdated(value.chat_id_, ChatTitleField);
                 }
             },
             [this](td::td_api::updateChatPhoto &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->photo_ = std::move(value.photo_);
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatPhotoField);
                 }
             },
             [this](td::td_api::updateChatPermissions &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->permissions_ = std::move(value.permissions_);
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatPermissionsField);
                 }
             },
             [this](td::td_api::updateChatLastMessage &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->last_message_ = std::move(value.last_message_);
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatLastMessageField);
                 }
 
                 setChatPositions(value.chat_id_, std::move(value.positions_));
@@ -174,28 +225,28 @@ void StorageManager::handleResult(td::td_api::Object *object)
                 {
                     it->second->last_read_inbox_message_id_ = value.last_read_inbox_message_id_;
                     it->second->unread_count_ = value.unread_count_;
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatReadInboxField);
                 }
             },
             [this](td::td_api::updateChatReadOutbox &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->last_read_outbox_message_id_ = value.last_read_outbox_message_id_;
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatReadOutboxField);
                 }
             },
             [this](td::td_api::updateChatActionBar &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->action_bar_ = std::move(value.action_bar_);
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatActionBarField);
                 }
             },
             [this](td::td_api::updateChatDraftMessage &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->draft_message_ = std::move(value.draft_message_);
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatDraftMessageField);
                 }
 
                 setChatPositions(value.chat_id_, std::move(value.positions_));
@@ -204,33 +255,40 @@ void StorageManager::handleResult(td::td_api::Object *object)
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->notification_settings_ = std::move(value.notification_settings_);
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatNotificationSettingsField);
                 }
             },
             [this](td::td_api::updateChatReplyMarkup &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->reply_markup_message_id_ = value.reply_markup_message_id_;
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatReplyMarkupField);
                 }
             },
             [this](td::td_api::updateChatUnreadMentionCount &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->unread_mention_count_ = value.unread_mention_count_;
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatUnreadMentionCountField);
                 }
             },
             [this](td::td_api::updateChatIsMarkedAsUnread &value) {
                 if (auto it = m_chats.find(value.chat_id_); it != m_chats.end())
                 {
                     it->second->is_marked_as_unread_ = value.is_marked_as_unread_;
-                    emit chatItemUpdated(value.chat_id_);
+                    emit chatItemUpdated(value.chat_id_, ChatIsMarkedAsUnreadField);
                 }
             },
-            [this](td::td_api::updateUser &value) { m_users.emplace(value.user_->id_, std::move(value.user_)); },
+            [this](td::td_api::updateChatAction &value) { m_chatActionTracker->setAction(value.chat_id_, *value.sender_id_, *value.action_); },
+            [this](td::td_api::updateUser &value) {
+                indexUser(*value.user_);
+                m_users.insert_or_assign(value.user_->id_, std::move(value.user_));
+            },
             [this](td::td_api::updateBasicGroup &value) { m_basicGroup.emplace(value.basic_group_->id_, std::move(value.basic_group_)); },
-            [this](td::td_api::updateSupergroup &value) { m_supergroup.emplace(value.supergroup_->id_, std::move(value.supergroup_)); },
+            [this](td::td_api::updateSupergroup &value) {
+                indexSupergroup(*value.supergroup_);
+                m_supergroup.insert_or_assign(value.supergroup_->id_, std::move(value.supergroup_));
+            },
             [this](td::td_api::updateUserFullInfo &value) { m_userFullInfo.emplace(value.user_id_, std::move(value.user_full_info_)); },
             [this](td::td_api::updateBasicGroupFullInfo &value) {
                 m_basicGroupFullInfo.emplace(value.basic_group_id_, std::move(value.basic_group_full_info_));
@@ -273,3 +331,56 @@ void StorageManager::setChatPositions(qint64 chatId, std::vector<td::td_api::obj
 
     emit chatPositionUpdated(chatId);
 }
+
+void StorageManager::indexChat(const td::td_api::chat &chat)
+{
+    qint64 userId = 0;
+    qint64 supergroupId = 0;
+
+    switch (chat.type_->get_id())
+    {
+        case td::td_api::chatTypePrivate::ID:
+            userId = static_cast<const td::td_api::chatTypePrivate &>(*chat.type_).user_id_;
+            break;
+        case td::td_api::chatTypeSecret::ID:
+            userId = static_cast<const td::td_api::chatTypeSecret &>(*chat.type_).user_id_;
+            break;
+        case td::td_api::chatTypeSupergroup::ID:
+            supergroupId = static_cast<const td::td_api::chatTypeSupergroup &>(*chat.type_).supergroup_id_;
+            break;
+        default:
+            break;
+    }
+
+    m_chatSearchIndex.setChat(chat.id_, QString::fromStdString(chat.title_), userId, supergroupId);
+}
+
+void StorageManager::indexUser(const td::td_api::user &user)
+{
+    QStringList usernames;
+
+    if (const auto &value = user.usernames_; value)
+    {
+        for (const auto &username : value->active_usernames_)
+        {
+            usernames.append(QString::fromStdString(username));
+        }
+    }
+
+    m_chatSearchIndex.setUser(user.id_, QString::fromStdString(user.first_name_), QString::fromStdString(user.last_name_), usernames);
+}
+
+void StorageManager::indexSupergroup(const td::td_api::supergroup &supergroup)
+{
+    QStringList usernames;
+
+    if (const auto &value = supergroup.usernames_; value)
+    {
+        for (const auto &username : value->active_usernames_)
+        {
+            usernames.append(QString::fromStdString(username));
+        }
+    }
+
+    m_chatSearchIndex.setSupergroup(supergroup.id_, usernames);
+}
@@ -1,7 +1,15 @@
 #pragma once
 
+#include "ChatActionTracker.hpp"
+#include "ChatSearchIndex.hpp"
+#include "DateBuckets.hpp"
 #include "Client.hpp"
+#include "HistoryPrefetcher.hpp"
 #include "Localization.hpp"
+#include "MessagePageCache.hpp"
+#include "MessageSearchIndex.hpp"
+#include "NavigationIndex.hpp"
+#include "RichTextCache.hpp"
 #include "Settings.hpp"
 
 #include <td/telegram/td_api.h>
@@ -23,12 +31,37 @@ public:
     StorageManager(const StorageManager &) = delete;
     StorageManager &operator=(const StorageManager &) = delete;
 
+    // Chat fields touched by an update, reported through chatItemUpdated
+    enum ChatField {
+        ChatTitleField = 0x0001,
+        ChatPhotoField = 0x0002,
+        ChatPermissionsField = 0x0004,
+        ChatLastMessageField = 0x0008,
+        ChatReadInboxField = 0x0010,
+        ChatReadOutboxField = 0x0020,
+        ChatActionBarField = 0x0040,
+        ChatDraftMessageField = 0x0080,
+        ChatNotificationSettingsField = 0x0100,
+        ChatReplyMarkupField = 0x0200,
+        ChatUnreadMentionCountField = 0x0400,
+        ChatIsMarkedAsUnreadField = 0x0800,
+    };
+
+    [[nodiscard]] ChatActionTracker *chatActionTracker() const noexcept;
     [[nodiscard]] Client *client() const noexcept;
+    [[nodiscard]] DateBuckets *dateBuckets() const noexcept;
+    [[nodiscard]] HistoryPrefetcher *historyPrefetcher() const noexcept;
     [[nodiscard]] Locale *locale() const noexcept;
+    [[nodiscard]] MessagePageCache *messagePageCache() const noexcept;
+    [[nodiscard]] MessageSearchIndex *messageSearchIndex() const noexcept;
+    [[nodiscard]] NavigationIndex *navigationIndex() const noexcept;
+    [[nodiscard]] RichTextCache *richTextCache() const noexcept;
     [[nodiscard]] Settings *settings() const noexcept;
 
     [[nodiscard]] std::vector<int64_t> chatIds() const noexcept;
 
+    [[nodiscard]] const ChatSearchIndex &chatSearchIndex() const noexcept;
+
     [[nodiscard]] const td::td_api::basicGroup *basicGroup(qint64 groupId) const noexcept;
     [[nodiscard]] const td::td_api::basicGroupFullInfo *basicGroupFullInfo(qint64 groupId) const noexcept;
     [[nodiscard]] const td::td_api::chat *chat(qint64 chatId) const noexcept;
@@ -49,7 +82,7 @@ public:
     [[nodiscard]] qint64 myId() const noexcept;
 
 signals:
-    void chatItemUpdated(qint64 chatId);
+    void chatItemUpdated(qint64 chatId, int fields);
     void chatPositionUpdated(qint64 chatId);
 
     void chatFoldersChanged();
@@ -71,11 +104,24 @@ private:
 
     void setChatPositions(qint64 chatId, std::vector<td::td_api::object_ptr<td::td_api::chatPosition>> &&positions) noexcept;
 
+    void indexChat(const td::td_api::chat &chat);
+    void indexUser(const td::td_api::user &user);
+    void indexSupergroup(const td::td_api::supergroup &supergroup);
+
     QVariantMap m_options;
 
     std::unique_ptr<Client> m_client;
     std::unique_ptr<Locale> m_locale;
     std::unique_ptr<Settings> m_settings;
+    std::unique_ptr<ChatActionTracker> m_chatActionTracker;
+    std::unique_ptr<DateBuckets> m_dateBuckets;
+    std::unique_ptr<HistoryPrefetcher> m_historyPrefetcher;
+    std::unique_ptr<MessagePageCache> m_messagePageCache;
+    std::unique_ptr<MessageSearchIndex> m_messageSearchIndex;
+    std::unique_ptr<NavigationIndex> m_navigationIndex;
+    std::unique_ptr<RichTextCache> m_richTextCache;
+
+    ChatSearchIndex m_chatSearchIndex;
 
     std::vector<const td::td_api::chatFolderInfo *> m_chatFolders;
     std::vector<const td::td_api::countryInfo *> m_countries;
@@ -1,172 +1,499 @@
 #include "TextFormatter.hpp"
 
-#include <QTextCharFormat>
-
-// clang-format off
-const std::unordered_map<QString, std::function<void(QTextCharFormat &, const QString &, const QVariantMap &)>> TextFormatter::s_formatters = {
-    {"textEntityTypeBold", [](QTextCharFormat &format, const QString &, const QVariantMap &) { format.setFontWeight(QFont::Bold); }},
-    {"textEntityTypeItalic", [](QTextCharFormat &format, const QString &, const QVariantMap &) { format.setFontItalic(true); }},
-    {"textEntityTypeUnderline", [](QTextCharFormat &format, const QString &, const QVariantMap &) { format.setFontUnderline(true); }},
-    {"textEntityTypeStrikethrough", [](QTextCharFormat &format, const QString &, const QVariantMap &) { format.setFontStrikeOut(true); }},
-    {"textEntityTypeCode", [](QTextCharFormat &format, const QString &, const QVariantMap &) { format.setFontFamily("Courier"); }},
-    {"textEntityTypePre", [](QTextCharFormat &format, const QString &, const QVariantMap &) { format.setFontFamily("Courier"); }},
-    {"textEntityTypeTextUrl", [](QTextCharFormat &format, const QString &entityText, const QVariantMap &type) {
-         QString url = type.value("url").toString();
-         if (url.isEmpty())
-         {
-             url = entityText;
-         }
-         format.setAnchor(true);
-         format.setAnchorHref(url);
-         format.setFontUnderline(true);
-     }},
-    {"textEntityTypeUrl", [](QTextCharFormat &format, const QString &entityText, const QVariantMap &) {
-         format.setAnchor(true);
-         format.setAnchorHref(entityText);
-         format.setFontUnderline(true);
-     }},
-    {"textEntityTypeEmailAddress", [](QTextCharFormat &format, const QString &entityText, const QVariantMap &) {
-         format.setAnchor(true);
-         format.setAnchorHref("mailto:" + entityText);
-     }},
-    {"textEntityTypePhoneNumber", [](QTextCharFormat &format, const QString &entityText, const QVariantMap &) {
-         format.setAnchor(true);
-         format.setAnchorHref("tel:" + entityText);
-     }},
-    {"textEntityTypeMention", [](QTextCharFormat &format, const QString &entityText, const QVariantMap &) {
-         format.setAnchor(true);
-         format.setAnchorHref("mention:" + entityText);
-     }},
-    {"textEntityTypeMentionName", [](QTextCharFormat &format, const QString &, const QVariantMap &entity) {
-         format.setAnchor(true);
-         format.setAnchorHref("mention_name:" + QString::number(entity.value("user_id").toInt()));
-     }},
-    {"textEntityTypeHashtag", [](QTextCharFormat &format, const QString &entityText, const QVariantMap &) {
-         format.setAnchor(true);
-         format.setAnchorHref("hashtag:" + entityText);
-     }},
-    {"textEntityTypeCashtag", [](QTextCharFormat &format, const QString &entityText, const QVariantMap &) {
-         format.setAnchor(true);
-         format.setAnchorHref("cashtag:" + entityText);
-     }},
-    {"textEntityTypeBotCommand", [](QTextCharFormat &format, const QString &entityText, const QVariantMap &) {
-         format.setAnchor(true);
-         format.setAnchorHref("botCommand:" + entityText);
-     }}};
-
-// clang-format on
+#include "TextScanner.hpp"
 
-TextFormatter::TextFormatter(QObject *parent)
-    : QObject(parent)
-    , m_document(std::make_unique<QTextDocument>(this))
-    , m_cursor(std::make_unique<QTextCursor>(m_document.get()))
-{
-    connect(this, SIGNAL(formattedTextChanged()), this, SLOT(applyFormatting()));
-}
+#include <QStringRef>
 
-TextFormatter::~TextFormatter() = default;
+#include <algorithm>
+#include <iterator>
+#include <utility>
 
-QString TextFormatter::text() const
+namespace {
+
+enum class Markup {
+    None,
+    Bold,
+    Italic,
+    Underline,
+    Strikethrough,
+    Code,
+    Pre,
+    Link,
+    Emoji,
+};
+
+struct EntityFormat
+{
+    Markup markup = Markup::None;
+    // Prefix of the link target, which is the entity text unless the entity carries its own
+    const char *scheme = "";
+};
+
+// Resolved at compile time into a jump over the type ids
+EntityFormat getEntityFormat(std::int32_t type) noexcept
 {
-    return m_document->toHtml();
+    switch (type)
+    {
+        case td::td_api::textEntityTypeBold::ID:
+            return {Markup::Bold};
+        case td::td_api::textEntityTypeItalic::ID:
+            return {Markup::Italic};
+        case td::td_api::textEntityTypeUnderline::ID:
+            return {Markup::Underline};
+        case td::td_api::textEntityTypeStrikethrough::ID:
+            return {Markup::Strikethrough};
+        case td::td_api::textEntityTypeCode::ID:
+            return {Markup::Code};
+        case td::td_api::textEntityTypePre::ID:
+        case td::td_api::textEntityTypePreCode::ID:
+            return {Markup::Pre};
+        case td::td_api::textEntityTypeTextUrl::ID:
+        case td::td_api::textEntityTypeUrl::ID:
+            return {Markup::Link};
+        case td::td_api::textEntityTypeEmailAddress::ID:
+            return {Markup::Link, "mailto:"};
+        case td::td_api::textEntityTypePhoneNumber::ID:
+            return {Markup::Link, "tel:"};
+        case td::td_api::textEntityTypeMention::ID:
+            return {Markup::Link, "mention:"};
+        case td::td_api::textEntityTypeMentionName::ID:
+            return {Markup::Link, "mention_name:"};
+        case td::td_api::textEntityTypeHashtag::ID:
+            return {Markup::Link, "hashtag:"};
+        case td::td_api::textEntityTypeCashtag::ID:
+            return {Markup::Link, "cashtag:"};
+        case td::td_api::textEntityTypeBotCommand::ID:
+            return {Markup::Link, "botCommand:"};
+        default:
+            return {};
+    }
 }
 
-QFont TextFormatter::font() const
+// Escapes [from, to) of source in one pass; line breaks become explicit, spaces are kept by the white-space style of the whole text
+void appendEscaped(QString &html, const QString &source, int from, int to)
 {
-    return m_document->defaultFont();
+    const auto *data = source.constData();
+    auto run = from;
+
+    for (auto i = from; i < to; ++i)
+    {
+        const char *replacement = nullptr;
+
+        switch (data[i].unicode())
+        {
+            case '<':
+                replacement = "&lt;";
+                break;
+            case '>':
+                replacement = "&gt;";
+                break;
+            case '&':
+                replacement = "&amp;";
+                break;
+            case '"':
+                replacement = "&quot;";
+                break;
+            case '\n':
+                replacement = "<br>";
+                break;
+            default:
+                continue;
+        }
+
+        html += source.midRef(run, i - run);
+        html += QLatin1String(replacement);
+        run = i + 1;
+    }
+
+    html += source.midRef(run, to - run);
 }
 
-void TextFormatter::setFont(const QFont &value)
+void appendOpeningTag(QString &html, const TextFormatter::Entity &entity, Markup markup, const QString &text)
 {
-    if (value != m_document->defaultFont())
+    switch (markup)
     {
-        m_document->setDefaultFont(value);
-        emit fontChanged();
+        case Markup::None:
+            break;
+        case Markup::Bold:
+            html += QLatin1String("<b>");
+            break;
+        case Markup::Italic:
+            html += QLatin1String("<i>");
+            break;
+        case Markup::Underline:
+            html += QLatin1String("<u>");
+            break;
+        case Markup::Strikethrough:
+            html += QLatin1String("<s>");
+            break;
+        case Markup::Code:
+        case Markup::Pre:
+            html += QLatin1String("<font face=\"Courier\">");
+            break;
+        case Markup::Emoji:
+            html += QLatin1String("<font face=\"Noto Emoji\">");
+            break;
+        case Markup::Link: {
+            html += QLatin1String("<a href=\"");
+
+            // The target is the entity text unless the entity carries its own
+            if (entity.type == td::td_api::textEntityTypeTextUrl::ID && !entity.url.isEmpty())
+            {
+                appendEscaped(html, entity.url, 0, entity.url.size());
+            }
+            else if (entity.type == td::td_api::textEntityTypeMentionName::ID)
+            {
+                html += QLatin1String(getEntityFormat(entity.type).scheme);
+                html += QString::number(entity.userId);
+            }
+            else
+            {
+                html += QLatin1String(getEntityFormat(entity.type).scheme);
+                appendEscaped(html, text, entity.offset, entity.offset + entity.length);
+            }
+
+            html += QLatin1String("\">");
+            break;
+        }
     }
 }
 
-QVariant TextFormatter::formattedText() const
+void appendClosingTag(QString &html, Markup markup)
 {
-    return m_formattedText;
+    switch (markup)
+    {
+        case Markup::None:
+            break;
+        case Markup::Bold:
+            html += QLatin1String("</b>");
+            break;
+        case Markup::Italic:
+            html += QLatin1String("</i>");
+            break;
+        case Markup::Underline:
+            html += QLatin1String("</u>");
+            break;
+        case Markup::Strikethrough:
+            html += QLatin1String("</s>");
+            break;
+        case Markup::Code:
+        case Markup::Pre:
+        case Markup::Emoji:
+            html += QLatin1String("</font>");
+            break;
+        case Markup::Link:
+            html += QLatin1String("</a>");
+            break;
+    }
 }
 
-void TextFormatter::setFormattedText(const QVariant &value)
+// The entities of source followed by the ones the scanner finds; the markup of entities that are not shown is None
+void collectEntities(const TextFormatter::Source &source, std::vector<TextFormatter::Entity> &entities, std::vector<Markup> &markups)
 {
-    if (m_formattedText != value)
+    const auto &text = source.text;
+
+    // Text without entities is linked the way TDLib would, emoji are drawn from the bundled font either way
+    const auto spans = TextScanner::scan(text, source.entities.empty());
+
+    entities.reserve(source.entities.size() + spans.size());
+    entities.insert(entities.end(), source.entities.begin(), source.entities.end());
+
+    markups.assign(entities.size(), Markup::None);
+    markups.reserve(entities.size() + spans.size());
+
+    for (std::size_t i = 0; i < source.entities.size(); ++i)
     {
-        m_formattedText = value;
-        emit formattedTextChanged();
+        const auto &entity = entities[i];
+
+        // Offsets are in UTF-16 code units, which is what QString indexes
+        if (entity.offset >= 0 && entity.length > 0 && entity.offset + entity.length <= text.size())
+            markups[i] = getEntityFormat(entity.type).markup;
+    }
+
+    for (const auto &span : spans)
+    {
+        TextFormatter::Entity entity;
+        entity.offset = span.offset;
+        entity.length = span.length;
+
+        switch (span.kind)
+        {
+            case TextScanner::Kind::Url:
+                entity.type = td::td_api::textEntityTypeUrl::ID;
+
+                // Scanned links start with a scheme or with www., the latter would not open as it is
+                if (text.at(span.offset).toLower() == QLatin1Char('w'))
+                {
+                    entity.type = td::td_api::textEntityTypeTextUrl::ID;
+                    entity.url = QLatin1String("http://") + text.mid(span.offset, span.length);
+                }
+                break;
+            case TextScanner::Kind::Mention:
+                entity.type = td::td_api::textEntityTypeMention::ID;
+                break;
+            case TextScanner::Kind::Hashtag:
+                entity.type = td::td_api::textEntityTypeHashtag::ID;
+                break;
+            case TextScanner::Kind::Emoji:
+                break;
+        }
+
+        markups.push_back(span.kind == TextScanner::Kind::Emoji ? Markup::Emoji : Markup::Link);
+        entities.emplace_back(std::move(entity));
     }
 }
 
-void TextFormatter::applyFormatting()
+// Where an entity starts or ends; entities are referred to by index
+struct Boundary
+{
+    int position{};
+    int entity{};
+    bool opening{};
+};
+
+}  // namespace
+
+TextFormatter::TextFormatter(QObject *parent)
+    : QObject(parent)
 {
-    if (m_formattedText.canConvert<QString>())
+    connect(this, SIGNAL(formattedTextChanged()), this, SLOT(applyFormatting()));
+}
+
+TextFormatter::Source TextFormatter::toSource(const td::td_api::formattedText &formattedText)
+{
+    Source source;
+    source.text = QString::fromStdString(formattedText.text_);
+    source.entities.reserve(formattedText.entities_.size());
+
+    for (const auto &value : formattedText.entities_)
     {
-        m_document->setPlainText(m_formattedText.toString());
-        emit textChanged();
-        return;
+        Entity entity;
+        entity.offset = value->offset_;
+        entity.length = value->length_;
+        entity.type = value->type_->get_id();
+
+        if (entity.type == td::td_api::textEntityTypeTextUrl::ID)
+            entity.url = QString::fromStdString(static_cast<const td::td_api::textEntityTypeTextUrl &>(*value->type_).url_);
+        else if (entity.type == td::td_api::textEntityTypeMentionName::ID)
+            entity.userId = static_cast<const td::td_api::textEntityTypeMentionName &>(*value->type_).user_id_;
+
+        source.entities.emplace_back(std::move(entity));
     }
 
-    const auto formattedText = m_formattedText.toMap();
-    if (formattedText.value("@type").toString() != "formattedText" || formattedText.value("text").toString().isEmpty())
+    return source;
+}
+
+QString TextFormatter::toHtml(const td::td_api::formattedText &formattedText)
+{
+    return toHtml(toSource(formattedText));
+}
+
+QString TextFormatter::toHtml(const Source &source)
+{
+    const auto &text = source.text;
+
+    std::vector<Entity> entities;
+    std::vector<Markup> markups;
+    collectEntities(source, entities, markups);
+
+    std::vector<Boundary> boundaries;
+    boundaries.reserve(markups.size() * 2);
+
+    for (int i = 0; i < static_cast<int>(entities.size()); ++i)
     {
-        return;
+        if (markups[i] == Markup::None)
+            continue;
+
+        boundaries.push_back({entities[i].offset, i, true});
+        boundaries.push_back({entities[i].offset + entities[i].length, i, false});
     }
 
-    const auto text = formattedText.value("text").toString();
-    const auto entities = formattedText.value("entities").toList();
+    // At one position entities end before others start, outer ones open first and close last
+    std::ranges::sort(boundaries, [&entities](const Boundary &a, const Boundary &b) {
+        if (a.position != b.position)
+            return a.position < b.position;
+        if (a.opening != b.opening)
+            return !a.opening;
+
+        const auto &first = entities[a.entity];
+        const auto &second = entities[b.entity];
+
+        if (a.opening)
+            return first.length != second.length ? first.length > second.length : a.entity < b.entity;
+
+        return first.offset != second.offset ? first.offset > second.offset : a.entity > b.entity;
+    });
+
+    QString html;
+    html.reserve(text.size() + text.size() / 4 + static_cast<int>(boundaries.size()) * 8 + 64);
+    html += QLatin1String("<span style=\"white-space:pre-wrap\">");
 
     bool removeLineBreakAfterCodeBlock = false;
-    int currentIndex = 0;
+    int position = 0;
+
+    const auto appendText = [&](int to) {
+        if (position == to)
+            return;
+
+        if (removeLineBreakAfterCodeBlock && text.at(position) == QLatin1Char('\n'))
+            ++position;
+
+        removeLineBreakAfterCodeBlock = false;
 
-    auto insertTextSegment = [&](const QString &textSegment) {
-        if (removeLineBreakAfterCodeBlock && textSegment.startsWith('\n'))
+        appendEscaped(html, text, position, to);
+        position = to;
+    };
+
+    // Entities open at the current position, innermost last
+    std::vector<int> open;
+    bool linkOpen = false;
+
+    for (const auto &boundary : boundaries)
+    {
+        appendText(boundary.position);
+
+        const auto &entity = entities[boundary.entity];
+        const auto markup = markups[boundary.entity];
+
+        if (boundary.opening)
         {
-            m_cursor->insertText(textSegment.mid(1));
-            removeLineBreakAfterCodeBlock = false;
+            // Links cannot be nested, the inner one is shown as plain text
+            if (markup == Markup::Link && std::exchange(linkOpen, true))
+            {
+                markups[boundary.entity] = Markup::None;
+                continue;
+            }
+
+            open.push_back(boundary.entity);
+            appendOpeningTag(html, entity, markup, text);
+            continue;
         }
-        else
+
+        if (markup == Markup::None)
+            continue;
+
+        // An entity overlapping the ones opened after it closes them, and they are reopened right away
+        const auto it = std::ranges::find(open, boundary.entity);
+        if (it == open.end())
+            continue;
+
+        for (auto inner = open.rbegin(); inner.base() != std::next(it); ++inner)
         {
-            m_cursor->insertText(textSegment);
+            appendClosingTag(html, markups[*inner]);
         }
-    };
 
-    for (const auto &entityRef : entities)
-    {
-        const auto entity = entityRef.toMap();
-        const auto offset = entity.value("offset").toInt();
-        const auto length = entity.value("length").toInt();
-        const auto type = entity.value("type").toMap();
-        const auto entityType = type.value("@type").toString();
+        appendClosingTag(html, markup);
 
-        if (currentIndex > offset)
+        for (auto inner = std::next(it); inner != open.end(); ++inner)
         {
-            continue;
+            appendOpeningTag(html, entities[*inner], markups[*inner], text);
         }
 
-        insertTextSegment(text.mid(currentIndex, offset - currentIndex));
+        open.erase(it);
 
-        const auto entityText = text.mid(offset, length);
-        QTextCharFormat format;
+        if (markup == Markup::Link)
+            linkOpen = false;
+        else if (markup == Markup::Pre)
+            removeLineBreakAfterCodeBlock = true;
+    }
+
+    appendText(text.size());
 
-        if (auto it = s_formatters.find(entityType); it != s_formatters.end())
+    html += QLatin1String("</span>");
+    return html;
+}
+
+TextFormatter::Plain TextFormatter::toPlain(const Source &source)
+{
+    const auto &text = source.text;
+
+    std::vector<Entity> entities;
+    std::vector<Markup> markups;
+    collectEntities(source, entities, markups);
+
+    // toHtml drops the line break right after a code block
+    std::vector<int> dropped;
+
+    for (int i = 0; i < static_cast<int>(entities.size()); ++i)
+    {
+        const auto end = entities[i].offset + entities[i].length;
+
+        if (markups[i] == Markup::Pre && end < text.size() && text.at(end) == QLatin1Char('\n'))
+            dropped.push_back(end);
+    }
+
+    std::ranges::sort(dropped);
+    dropped.erase(std::unique(dropped.begin(), dropped.end()), dropped.end());
+
+    const auto shifted = [&dropped](int position) {
+        return position - static_cast<int>(std::ranges::lower_bound(dropped, position) - dropped.begin());
+    };
+
+    Plain result;
+    result.text.reserve(text.size());
+
+    auto position = 0;
+    for (auto skip : dropped)
+    {
+        result.text += text.midRef(position, skip - position);
+        position = skip + 1;
+    }
+
+    result.text += text.midRef(position);
+
+    for (int i = 0; i < static_cast<int>(entities.size()); ++i)
+    {
+        Run run;
+
+        switch (markups[i])
         {
-            it->second(format, entityText, entity);
-            if (entityType == "textEntityTypePre")
-            {
-                removeLineBreakAfterCodeBlock = true;
-            }
+            case Markup::Bold:
+                run.bold = true;
+                break;
+            case Markup::Italic:
+                run.italic = true;
+                break;
+            case Markup::Code:
+            case Markup::Pre:
+                run.monospace = true;
+                break;
+            case Markup::Emoji:
+                run.emoji = true;
+                break;
+            default:
+                continue;
         }
 
-        m_cursor->insertText(entityText, format);
-        currentIndex = offset + length;
+        run.offset = shifted(entities[i].offset);
+        run.length = shifted(entities[i].offset + entities[i].length) - run.offset;
+
+        result.runs.push_back(run);
     }
 
-    if (currentIndex < text.length())
+    return result;
+}
+
+QString TextFormatter::text() const
+{
+    return m_text;
+}
+
+QVariant TextFormatter::formattedText() const
+{
+    return m_formattedText;
+}
+
+void TextFormatter::setFormattedText(const QVariant &value)
+{
+    if (m_formattedText != value)
     {
-        insertTextSegment(text.mid(currentIndex));
+        m_formattedText = value;
+        emit formattedTextChanged();
     }
+}
 
+void TextFormatter::applyFormatting()
+{
+    m_text = toHtml(Source{m_formattedText.toString(), {}});
     emit textChanged();
 }
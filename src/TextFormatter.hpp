@@ -1,38 +1,73 @@
 #pragma once
 
-#include "Common.hpp"
+#include <td/telegram/td_api.h>
 
 #include <QObject>
-#include <QTextCursor>
-#include <QTextDocument>
 #include <QVariant>
 
-#include <functional>
-#include <memory>
-#include <unordered_map>
+#include <cstdint>
+#include <vector>
 
+// Turns formatted text into the rich text subset Text elements render. Text without entities gets
+// its links found by TextScanner, and emoji are set in the bundled emoji font. Models format
+// td_api::formattedText directly; the QML element is left for plain strings.
 class TextFormatter : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(QString text READ text NOTIFY textChanged)
-    Q_PROPERTY(QFont font READ font WRITE setFont NOTIFY fontChanged)
     Q_PROPERTY(QVariant formattedText READ formattedText WRITE setFormattedText NOTIFY formattedTextChanged)
 
 public:
+    // A copy of formatted text that owns its strings, so that it can be formatted on another thread
+    struct Entity
+    {
+        int offset{};
+        int length{};
+        std::int32_t type{};
+        // Link target of text URLs and user of mention names
+        QString url;
+        qint64 userId{};
+    };
+
+    struct Source
+    {
+        QString text;
+        std::vector<Entity> entities;
+    };
+
+    // Text as toHtml shows it, with the runs set in another font or style, so that it can be measured without parsing rich text
+    struct Run
+    {
+        int offset{};
+        int length{};
+        bool bold{};
+        bool italic{};
+        bool monospace{};
+        bool emoji{};
+    };
+
+    struct Plain
+    {
+        QString text;
+        std::vector<Run> runs;
+    };
+
     explicit TextFormatter(QObject *parent = nullptr);
-    ~TextFormatter() override;
 
-    QString text() const;
+    [[nodiscard]] static Source toSource(const td::td_api::formattedText &formattedText);
 
-    QFont font() const;
-    void setFont(const QFont &value);
+    [[nodiscard]] static QString toHtml(const Source &source);
+    [[nodiscard]] static QString toHtml(const td::td_api::formattedText &formattedText);
+
+    [[nodiscard]] static Plain toPlain(const Source &source);
+
+    QString text() const;
 
     QVariant formattedText() const;
     void setFormattedText(const QVariant &value);
 
 signals:
     void textChanged();
-    void fontChanged();
     void formattedTextChanged();
 
 private slots:
@@ -40,9 +75,5 @@ private slots:
 
 private:
     QVariant m_formattedText;
-
-    std::unique_ptr<QTextDocument> m_document;
-    std::unique_ptr<QTextCursor> m_cursor;
-
-    static const std::unordered_map<QString, std::function<void(QTextCharFormat &, const QString &, const QVariantMap &)>> s_formatters;
+    QString m_text;
 };
@@ -0,0 +1,137 @@
+#include "TextFormatterPool.hpp"
+
+#include <QRunnable>
+#include <QThread>
+
+#include <algorithm>
+
+class TextFormatterPool::Job : public QRunnable
+{
+public:
+    Job(TextFormatterPool *pool, quint64 serial, std::shared_ptr<Task> task)
+        : m_pool(pool)
+        , m_serial(serial)
+        , m_task(std::move(task))
+    {
+    }
+
+    void run() override
+    {
+        // A prioritized request is queued twice, the job that starts second has nothing left to do
+        if (m_task->started.test_and_set())
+            return;
+
+        auto text = TextFormatter::toHtml(m_task->request.source);
+
+        bool publish = false;
+
+        {
+            std::lock_guard lock(m_pool->m_mutex);
+            m_pool->m_ready.push_back({m_serial, m_task->request.key.messageId, std::move(text)});
+
+            // One queued publish collects everything finished until it runs
+            publish = !std::exchange(m_pool->m_publishQueued, true);
+        }
+
+        if (publish)
+            QMetaObject::invokeMethod(m_pool, "publish", Qt::QueuedConnection);
+    }
+
+private:
+    TextFormatterPool *m_pool;
+    quint64 m_serial;
+    std::shared_ptr<Task> m_task;
+};
+
+TextFormatterPool::TextFormatterPool(RichTextCache *cache, QObject *parent)
+    : QObject(parent)
+    , m_cache(cache)
+{
+    // The GUI thread keeps a core to itself where there is more than one
+    m_pool.setMaxThreadCount(std::clamp(QThread::idealThreadCount() - 1, 1, MaxThreadCount));
+}
+
+TextFormatterPool::~TextFormatterPool()
+{
+    // Jobs refer back to this object
+    m_pool.waitForDone();
+}
+
+void TextFormatterPool::format(std::vector<Request> &&requests, bool urgent)
+{
+    // Priorities only order queued jobs, so the first requests of a batch get the higher ones
+    auto priority = static_cast<int>(requests.size()) + (urgent ? UrgentPriority : 0);
+
+    for (auto &request : requests)
+    {
+        if (m_pending.contains(request.key.messageId))
+            continue;
+
+        auto task = std::make_shared<Task>();
+        task->request = std::move(request);
+
+        const auto serial = ++m_serial;
+        m_pending.emplace(task->request.key.messageId, Pending{serial, task, task->request.key, urgent});
+
+        m_pool.start(new Job(this, serial, std::move(task)), priority--);
+    }
+}
+
+bool TextFormatterPool::isPending(qint64 messageId) const
+{
+    return m_pending.contains(messageId);
+}
+
+void TextFormatterPool::prioritize(qint64 messageId)
+{
+    auto it = m_pending.find(messageId);
+    if (it == m_pending.end() || std::exchange(it->second.urgent, true))
+        return;
+
+    // QThreadPool cannot move a queued job, so a second one goes ahead of the queue
+    m_pool.start(new Job(this, it->second.serial, it->second.task), UrgentPriority + 1);
+}
+
+void TextFormatterPool::forget(qint64 messageId)
+{
+    m_pending.erase(messageId);
+}
+
+void TextFormatterPool::setEditDate(qint64 messageId, qint32 editDate)
+{
+    if (auto it = m_pending.find(messageId); it != m_pending.end())
+        it->second.key.editDate = editDate;
+}
+
+void TextFormatterPool::clear()
+{
+    m_pending.clear();
+}
+
+void TextFormatterPool::publish()
+{
+    std::vector<Result> ready;
+
+    {
+        std::lock_guard lock(m_mutex);
+        ready.swap(m_ready);
+        m_publishQueued = false;
+    }
+
+    QList<qint64> messageIds;
+
+    for (auto &[serial, messageId, text] : ready)
+    {
+        const auto it = m_pending.find(messageId);
+        if (it == m_pending.end() || it->second.serial != serial)
+            continue;
+
+        m_cache->insert(it->second.key, std::move(text));
+        m_pending.erase(it);
+
+        messageIds.append(messageId);
+    }
+
+    if (!messageIds.isEmpty())
+        emit formattedReady(messageIds);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "RichTextCache.hpp"
+#include "TextFormatter.hpp"
+
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Formats message text into rich text on worker threads. Results go into the rich text
+// cache on the GUI thread, formattedReady reports the messages that have theirs now.
+class TextFormatterPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Request
+    {
+        RichTextCache::Key key;
+        TextFormatter::Source source;
+    };
+
+    explicit TextFormatterPool(RichTextCache *cache, QObject *parent = nullptr);
+    ~TextFormatterPool() override;
+
+    // Requests are started in the order given, urgent ones ahead of everything queued
+    void format(std::vector<Request> &&requests, bool urgent = false);
+
+    [[nodiscard]] bool isPending(qint64 messageId) const;
+
+    // Queues the pending request of a message again as urgent, whichever of the two jobs starts first formats it
+    void prioritize(qint64 messageId);
+
+    // Drops the pending request of a message whose content changed; its result is discarded when it finishes
+    void forget(qint64 messageId);
+
+    // Publishes the pending request of an edited message under its new version
+    void setEditDate(qint64 messageId, qint32 editDate);
+
+    // Forgets the requests of the previous chat; whatever of them is still queued is dropped when it finishes
+    void clear();
+
+signals:
+    void formattedReady(const QList<qint64> &messageIds);
+
+private slots:
+    void publish();
+
+private:
+    class Job;
+
+    // Shared by the jobs queued for one request
+    struct Task
+    {
+        Request request;
+        std::atomic_flag started;
+    };
+
+    struct Pending
+    {
+        quint64 serial{};
+        std::shared_ptr<Task> task;
+        // The key the result goes into the cache under, jobs do not see edits made while they are queued
+        RichTextCache::Key key;
+        bool urgent = false;
+    };
+
+    struct Result
+    {
+        quint64 serial{};
+        qint64 messageId{};
+        QString text;
+    };
+
+    static constexpr auto MaxThreadCount = 2;
+
+    // Above any batch, so that urgent requests start next
+    static constexpr auto UrgentPriority = 1 << 20;
+
+    RichTextCache *m_cache{};
+
+    QThreadPool m_pool;
+
+    // Every request gets a serial; a result is only published while it is still the pending one of its message,
+    // so results of a previous chat or of replaced content are dropped
+    quint64 m_serial{};
+
+    std::unordered_map<qint64, Pending> m_pending;
+
+    std::mutex m_mutex;
+    std::vector<Result> m_ready;
+    bool m_publishQueued = false;
+};
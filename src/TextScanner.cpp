@@ -0,0 +1,308 @@
+#include "TextScanner.hpp"
+
+#include <QChar>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Code units that can start a span besides '@', '#', ':' and '.': the symbol blocks from General Punctuation up to
+// CJK Compatibility, and the high surrogates of the emoji planes U+1F000 to U+1FBFF
+constexpr ushort SymbolsFirst = 0x2000;
+constexpr ushort SymbolsLast = 0x33ff;
+constexpr ushort EmojiSurrogateFirst = 0xd83c;
+constexpr ushort EmojiSurrogateLast = 0xd83e;
+
+constexpr ushort ZeroWidthJoiner = 0x200d;
+constexpr ushort CombiningKeycap = 0x20e3;
+constexpr ushort TextPresentationSelector = 0xfe0e;
+constexpr ushort EmojiPresentationSelector = 0xfe0f;
+constexpr char32_t TagFirst = 0xe0020;
+constexpr char32_t TagLast = 0xe007f;
+
+constexpr auto MaxMentionLength = 32;
+constexpr auto MinMentionLength = 3;
+constexpr auto MaxHashtagLength = 256;
+
+// Code points drawn from the emoji font, by the Unicode emoji data
+constexpr std::array<std::pair<char32_t, char32_t>, 27> EmojiRanges = {{
+    {0x203c, 0x203c},   {0x2049, 0x2049}, {0x2122, 0x2122}, {0x2139, 0x2139}, {0x2194, 0x2199}, {0x21a9, 0x21aa}, {0x231a, 0x231b},
+    {0x2328, 0x2328},   {0x23cf, 0x23cf}, {0x23e9, 0x23f3}, {0x23f8, 0x23fa}, {0x24c2, 0x24c2}, {0x25aa, 0x25ab}, {0x25b6, 0x25b6},
+    {0x25c0, 0x25c0},   {0x25fb, 0x25fe}, {0x2600, 0x27bf}, {0x2934, 0x2935}, {0x2b05, 0x2b07}, {0x2b1b, 0x2b1c}, {0x2b50, 0x2b50},
+    {0x2b55, 0x2b55},   {0x3030, 0x3030}, {0x303d, 0x303d}, {0x3297, 0x3297}, {0x3299, 0x3299}, {0x1f000, 0x1faff},
+}};
+
+bool isCandidate(ushort unit) noexcept
+{
+    return unit == '@' || unit == '#' || unit == ':' || unit == '.' || (unit >= SymbolsFirst && unit <= SymbolsLast) ||
+           (unit >= EmojiSurrogateFirst && unit <= EmojiSurrogateLast);
+}
+
+// Index of the first candidate in [from, size), or size
+int findCandidate(const ushort *data, int from, int size) noexcept
+{
+    auto i = from;
+
+#if defined(__SSE2__)
+    const auto at = _mm_set1_epi16('@');
+    const auto hash = _mm_set1_epi16('#');
+    const auto colon = _mm_set1_epi16(':');
+    const auto dot = _mm_set1_epi16('.');
+    const auto zero = _mm_setzero_si128();
+
+    // Unsigned first <= unit <= last: unit - first, saturated down by last - first, is zero
+    const auto inRange = [zero](__m128i units, ushort first, ushort last) {
+        const auto offset = _mm_sub_epi16(units, _mm_set1_epi16(static_cast<short>(first)));
+        return _mm_cmpeq_epi16(_mm_subs_epu16(offset, _mm_set1_epi16(static_cast<short>(last - first))), zero);
+    };
+
+    for (; i + 8 <= size; i += 8)
+    {
+        const auto units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+
+        auto mask = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(units, at), _mm_cmpeq_epi16(units, hash)),
+                                 _mm_or_si128(_mm_cmpeq_epi16(units, colon), _mm_cmpeq_epi16(units, dot)));
+        mask = _mm_or_si128(mask, inRange(units, SymbolsFirst, SymbolsLast));
+        mask = _mm_or_si128(mask, inRange(units, EmojiSurrogateFirst, EmojiSurrogateLast));
+
+        // Two mask bits per code unit
+        if (const auto bits = static_cast<unsigned>(_mm_movemask_epi8(mask)))
+            return i + std::countr_zero(bits) / 2;
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const auto inRange = [](uint16x8_t units, ushort first, ushort last) {
+        return vcleq_u16(vsubq_u16(units, vdupq_n_u16(first)), vdupq_n_u16(last - first));
+    };
+
+    for (; i + 8 <= size; i += 8)
+    {
+        const auto units = vld1q_u16(data + i);
+
+        auto mask = vorrq_u16(vorrq_u16(vceqq_u16(units, vdupq_n_u16('@')), vceqq_u16(units, vdupq_n_u16('#'))),
+                              vorrq_u16(vceqq_u16(units, vdupq_n_u16(':')), vceqq_u16(units, vdupq_n_u16('.'))));
+        mask = vorrq_u16(mask, inRange(units, SymbolsFirst, SymbolsLast));
+        mask = vorrq_u16(mask, inRange(units, EmojiSurrogateFirst, EmojiSurrogateLast));
+
+        // ARMv7 has no horizontal reduction, the halves are folded into one 64-bit lane; the scalar loop below finds the unit
+        const auto folded = vorr_u16(vget_low_u16(mask), vget_high_u16(mask));
+        if (vget_lane_u64(vreinterpret_u64_u16(folded), 0) != 0)
+            break;
+    }
+#endif
+
+    for (; i < size; ++i)
+    {
+        if (isCandidate(data[i]))
+            return i;
+    }
+
+    return size;
+}
+
+bool isEmoji(char32_t codePoint) noexcept
+{
+    const auto it = std::ranges::lower_bound(EmojiRanges, codePoint, std::ranges::less{}, &std::pair<char32_t, char32_t>::second);
+    return it != EmojiRanges.end() && codePoint >= it->first;
+}
+
+// The code point at i and the number of code units it takes
+std::pair<char32_t, int> codePointAt(const ushort *data, int i, int size) noexcept
+{
+    if ((data[i] & 0xfc00) == 0xd800 && i + 1 < size && (data[i + 1] & 0xfc00) == 0xdc00)
+        return {QChar::surrogateToUcs4(data[i], data[i + 1]), 2};
+
+    return {data[i], 1};
+}
+
+bool isWordCharacter(ushort unit) noexcept
+{
+    return unit == '_' || QChar(unit).isLetterOrNumber();
+}
+
+bool isUsernameCharacter(ushort unit) noexcept
+{
+    return (unit >= 'a' && unit <= 'z') || (unit >= 'A' && unit <= 'Z') || (unit >= '0' && unit <= '9') || unit == '_';
+}
+
+bool isUrlCharacter(ushort unit) noexcept
+{
+    if (unit == '<' || unit == '>' || unit == '"' || QChar(unit).isSpace())
+        return false;
+
+    return !(unit >= SymbolsFirst && unit <= SymbolsLast) && !(unit >= EmojiSurrogateFirst && unit <= EmojiSurrogateLast);
+}
+
+bool matchesLowercase(const ushort *data, int i, const char *word) noexcept
+{
+    for (; *word; ++i, ++word)
+    {
+        if ((data[i] | 0x20) != static_cast<ushort>(*word))
+            return false;
+    }
+
+    return true;
+}
+
+// End of the emoji sequence at i: modifiers, keycaps, tags and joined or adjacent emoji are one span
+int emojiEnd(const ushort *data, int i, int size) noexcept
+{
+    while (i < size)
+    {
+        const auto [codePoint, length] = codePointAt(data, i, size);
+
+        if (codePoint == EmojiPresentationSelector || codePoint == TextPresentationSelector || codePoint == CombiningKeycap ||
+            (codePoint >= TagFirst && codePoint <= TagLast) || isEmoji(codePoint))
+        {
+            i += length;
+        }
+        else if (codePoint == ZeroWidthJoiner && i + 1 < size && isEmoji(codePointAt(data, i + 1, size).first))
+        {
+            i += 1;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+// End of the URL whose address starts at i, without the punctuation it is usually followed by in a sentence
+int urlEnd(const ushort *data, int i, int size) noexcept
+{
+    auto end = i;
+    auto openParentheses = 0;
+
+    for (; end < size && isUrlCharacter(data[end]); ++end)
+    {
+        if (data[end] == '(')
+            ++openParentheses;
+        else if (data[end] == ')')
+            --openParentheses;
+    }
+
+    while (end > i)
+    {
+        const auto unit = data[end - 1];
+
+        if (unit == ')' && openParentheses < 0)
+            ++openParentheses;
+        else if (unit != '.' && unit != ',' && unit != ';' && unit != ':' && unit != '!' && unit != '?' && unit != '\'')
+            break;
+
+        --end;
+    }
+
+    return end;
+}
+
+}  // namespace
+
+std::vector<TextScanner::Span> TextScanner::scan(const QString &text, bool withLinks)
+{
+    std::vector<Span> spans;
+
+    const auto *data = text.utf16();
+    const auto size = text.size();
+
+    // Where the previous span ended; a link found from a later candidate must not start before it
+    auto spanEnd = 0;
+
+    for (auto i = findCandidate(data, 0, size); i < size; i = findCandidate(data, i, size))
+    {
+        const auto unit = data[i];
+        const auto atWordStart = [&](int start) { return start >= spanEnd && (start == 0 || !isWordCharacter(data[start - 1])); };
+
+        auto start = i;
+        auto end = i + 1;
+        auto kind = Kind::Emoji;
+
+        if (withLinks && (unit == '@' || unit == '#'))
+        {
+            if (!atWordStart(i))
+            {
+                ++i;
+                continue;
+            }
+
+            const auto limit = std::min(size, i + 1 + (unit == '@' ? MaxMentionLength : MaxHashtagLength));
+            auto hasLetter = false;
+
+            for (; end < limit && (unit == '@' ? isUsernameCharacter(data[end]) : isWordCharacter(data[end])); ++end)
+            {
+                hasLetter = hasLetter || !QChar(data[end]).isDigit();
+            }
+
+            // Longer runs are not usernames; hashtags of digits only are how numbers are written
+            const auto valid = unit == '@' ? end - i - 1 >= MinMentionLength && (end == size || !isUsernameCharacter(data[end]))
+                                           : hasLetter;
+
+            if (!valid)
+            {
+                i = end;
+                continue;
+            }
+
+            kind = unit == '@' ? Kind::Mention : Kind::Hashtag;
+        }
+        else if (withLinks && (unit == ':' || unit == '.'))
+        {
+            auto address = i;
+
+            // http:// and https:// links, and www. ones written without a scheme
+            if (unit == ':' && i + 2 < size && data[i + 1] == '/' && data[i + 2] == '/')
+            {
+                if (i >= 5 && matchesLowercase(data, i - 5, "https") && atWordStart(i - 5))
+                    start = i - 5;
+                else if (i >= 4 && matchesLowercase(data, i - 4, "http") && atWordStart(i - 4))
+                    start = i - 4;
+
+                address = i + 3;
+            }
+            else if (unit == '.' && i >= 3 && matchesLowercase(data, i - 3, "www") && atWordStart(i - 3))
+            {
+                start = i - 3;
+                address = i + 1;
+            }
+
+            if (start != i)
+                end = urlEnd(data, address, size);
+
+            // An address needs at least a host
+            if (start == i || end <= address)
+            {
+                ++i;
+                continue;
+            }
+
+            kind = Kind::Url;
+        }
+        else
+        {
+            const auto [codePoint, length] = codePointAt(data, i, size);
+
+            if (!isEmoji(codePoint))
+            {
+                i += length;
+                continue;
+            }
+
+            end = emojiEnd(data, i + length, size);
+        }
+
+        spans.push_back({start, end - start, kind});
+        spanEnd = i = end;
+    }
+
+    return spans;
+}
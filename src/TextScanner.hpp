@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QString>
+
+#include <vector>
+
+// Finds links, mentions, hashtags and emoji in plain text. Most text has none of them, so candidates are
+// looked for several code units at a time and only the units around a candidate are looked at closely.
+class TextScanner
+{
+public:
+    enum class Kind {
+        Url,
+        Mention,
+        Hashtag,
+        Emoji,
+    };
+
+    // Offsets and lengths are in UTF-16 code units, the same as those of text entities
+    struct Span
+    {
+        int offset{};
+        int length{};
+        Kind kind{};
+    };
+
+    // Spans are in text order and do not overlap; links, mentions and hashtags are only looked for when asked
+    [[nodiscard]] static std::vector<Span> scan(const QString &text, bool withLinks = true);
+};
@@ -270,6 +270,29 @@ bool Utils::isMeChat(const td::td_api::chat *chat, StorageManager *store) noexce
     return false;
 }
 
+QString Utils::getChatType(const td::td_api::chat &chat) noexcept
+{
+    switch (chat.type_->get_id())
+    {
+        case td::td_api::chatTypePrivate::ID:
+            return "private";
+
+        case td::td_api::chatTypeSecret::ID:
+            return "secret";
+
+        case td::td_api::chatTypeBasicGroup::ID:
+            return "group";
+
+        case td::td_api::chatTypeSupergroup::ID: {
+            const auto *value = static_cast<const td::td_api::chatTypeSupergroup *>(chat.type_.get());
+            return value->is_channel_ ? "channel" : "supergroup";
+        }
+
+        default:
+            return {};
+    }
+}
+
 QString Utils::getChatTitle(qint64 chatId, StorageManager *store, Locale *locale, bool showSavedMessages)
 {
     const auto chat = store->chat(chatId);
@@ -583,21 +606,9 @@ QString Utils::getTitle(const td::td_api::message &message, StorageManager *stor
     return {};
 }
 
-QString Utils::getMessageDate(const td::td_api::message &message, Locale *locale) noexcept
+QString Utils::getMessageDate(const td::td_api::message &message, StorageManager *store) noexcept
 {
-    const auto date = QDateTime::fromMSecsSinceEpoch(message.date_ * 1000);
-    const auto days = date.daysTo(QDateTime::currentDateTime());
-
-    if (days == 0)
-    {
-        return date.toString(locale->getString("formatterDay12H"));
-    }
-    else if (days < 7)
-    {
-        return date.toString(locale->getString("formatterWeek"));
-    }
-
-    return date.toString(locale->getString("formatterYear"));
+    return store->dateBuckets()->messageDate(message.date_);
 }
 
 QString Utils::getContent(const td::td_api::message &message, StorageManager *storageManager, Locale *locale) noexcept
@@ -850,3 +861,47 @@ QString Utils::formatTime(int totalSeconds) noexcept
 
     return result;
 }
+
+QString Utils::foldText(const QString &text) noexcept
+{
+    // Decompose first so that diacritics become separate marks we can drop
+    const auto decomposed = text.normalized(QString::NormalizationForm_KD);
+
+    QString result;
+    result.reserve(decomposed.size());
+
+    for (int i = 0; i < decomposed.size(); ++i)
+    {
+        if (const auto ch = decomposed.at(i); ch.category() != QChar::Mark_NonSpacing)
+        {
+            result.append(ch);
+        }
+    }
+
+    return result.toCaseFolded();
+}
+
+QStringList Utils::tokenizeText(const QString &text) noexcept
+{
+    const auto folded = foldText(text);
+
+    QStringList result;
+
+    int start = -1;
+    for (int i = 0; i <= folded.size(); ++i)
+    {
+        const auto isWordChar = i < folded.size() && (folded.at(i).isLetterOrNumber() || folded.at(i) == QLatin1Char('_'));
+
+        if (isWordChar && start < 0)
+        {
+            start = i;
+        }
+        else if (!isWordChar && start >= 0)
+        {
+            result.append(folded.mid(start, i - start));
+            start = -1;
+        }
+    }
+
+    return result;
+}
@@ -6,6 +6,7 @@
 
 #include <QImage>
 #include <QObject>
+#include <QStringList>
 #include <QVariant>
 
 class Locale;
@@ -49,6 +50,7 @@ public:
     static bool isChatPinned(const td::td_api::chat *chat, const ChatList &chatList);
     static qint64 getChatOrder(const td::td_api::chat *chat, const ChatList &chatList);
 
+    static QString getChatType(const td::td_api::chat &chat) noexcept;
     static QString getChatTitle(qint64 chatId, StorageManager *store, Locale *locale, bool showSavedMessages = false);
     static bool isChatMuted(qint64 chatId, StorageManager *store);
     static int getChatMuteFor(qint64 chatId, StorageManager *store);
@@ -62,7 +64,7 @@ public:
 
     static QString getContent(const td::td_api::message &message, StorageManager *store, Locale *locale) noexcept;
     static QString getTitle(const td::td_api::message &message, StorageManager *store, Locale *locale) noexcept;
-    static QString getMessageDate(const td::td_api::message &message, Locale *locale) noexcept;
+    static QString getMessageDate(const td::td_api::message &message, StorageManager *store) noexcept;
     static QString getMessageSenderName(const td::td_api::message &message, StorageManager *store, Locale *locale) noexcept;
 
     static bool isChatUnread(qint64 chatId, StorageManager *store) noexcept;
@@ -75,4 +77,7 @@ public:
     static QString getViews(int views) noexcept;
 
     static QString formatTime(int totalSeconds) noexcept;
+
+    static QString foldText(const QString &text) noexcept;
+    static QStringList tokenizeText(const QString &text) noexcept;
 };
@@ -10,6 +10,7 @@
 #include "Authorization.hpp"
 #include "Chat.hpp"
 #include "ChatModel.hpp"
+#include "ChatSearchModel.hpp"
 #include "Client.hpp"
 #include "Common.hpp"
 #include "DBusAdaptor.hpp"
@@ -41,11 +42,13 @@ Q_DECL_EXPORT int main(int argc, char *argv[])
     qRegisterMetaType<TdApi::AuthorizationState>("TdApi::AuthorizationState");
     qRegisterMetaType<TdApi::ChatList>("TdApi::ChatList");
     qRegisterMetaType<QModelIndex>("QModelIndex");
+    qRegisterMetaType<td::td_api::Object *>("td::td_api::Object *");
 
     qmlRegisterType<Authorization>("MyComponent", 1, 0, "Authorization");
     // qmlRegisterType<Chat>("MyComponent", 1, 0, "Chat");
 
     qmlRegisterType<ChatModel>("MyComponent", 1, 0, "ChatModel");
+    qmlRegisterType<ChatSearchModel>("MyComponent", 1, 0, "ChatSearchModel");
     qmlRegisterType<ChatFolderModel>("MyComponent", 1, 0, "ChatFolderModel");
     qmlRegisterType<CountryModel>("MyComponent", 1, 0, "CountryModel");
     qmlRegisterType<LanguagePackInfoModel>("MyComponent", 1, 0, "LanguagePackInfoModel");